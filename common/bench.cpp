@@ -0,0 +1,251 @@
+/*===============================================================*/
+/*                                                               */
+/*                           bench.cpp                           */
+/*                                                               */
+/*             Per-stage latency histograms for --bench          */
+/*                                                               */
+/*===============================================================*/
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+#include "bench.h"
+#include "perf_counters.h"
+
+static const char *stage_names[NUM_STAGES] = {
+	"decode",
+	"preprocess",
+	"pyramid",
+	"cascade",
+	"accelerator",
+	"group",
+	"output",
+	"end-to-end"
+};
+
+LatencyHistogram::LatencyHistogram(void): counts(BUCKETS, 0), n(0), largest(0) {}
+
+// Values below 2 * SUB_BUCKETS get a bucket each; above that, every power of
+// two [2^b, 2^(b+1)) is split into SUB_BUCKETS equal parts.
+int LatencyHistogram::bucket(unsigned long long ns) {
+	if (ns < 2 * SUB_BUCKETS) return ns;
+
+	int b = 63 - __builtin_clzll(ns);
+	if (b > MAX_BIT) return BUCKETS - 1;
+
+	return 2 * SUB_BUCKETS + (b - 6) * SUB_BUCKETS + (int) (ns >> (b - 5)) - SUB_BUCKETS;
+}
+
+unsigned long long LatencyHistogram::upper_bound(int bucket) {
+	if (bucket < 2 * SUB_BUCKETS) return bucket;
+
+	int b = 6 + (bucket - 2 * SUB_BUCKETS) / SUB_BUCKETS;
+	unsigned long long sub = SUB_BUCKETS + (bucket - 2 * SUB_BUCKETS) % SUB_BUCKETS;
+
+	return ((sub + 1) << (b - 5)) - 1;
+}
+
+void LatencyHistogram::record(unsigned long long ns) {
+	counts[bucket(ns)]++;
+	n++;
+	largest = std::max(largest, ns);
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other) {
+	for (int i = 0; i < BUCKETS; i++) counts[i] += other.counts[i];
+	n += other.n;
+	largest = std::max(largest, other.largest);
+}
+
+unsigned long long LatencyHistogram::percentile(double p) const {
+	if (!n) return 0;
+
+	unsigned long long target = std::max(1ULL, (unsigned long long) ceil(p * n));
+	unsigned long long seen = 0;
+
+	for (int i = 0; i < BUCKETS; i++) {
+		seen += counts[i];
+		if (seen >= target) return std::min(upper_bound(i), largest);
+	}
+
+	return largest;
+}
+
+BenchStats::BenchStats(void): detector(), n_frames(0), n_bytes(0) {
+	begin = end = std::chrono::steady_clock::now();
+}
+
+void BenchStats::start(void) {
+	begin = end = std::chrono::steady_clock::now();
+}
+
+void BenchStats::record(bench_stage stage, std::chrono::steady_clock::duration d) {
+	record(stage, (long long) std::chrono::duration_cast<std::chrono::nanoseconds>(d).count());
+}
+
+void BenchStats::record(bench_stage stage, long long ns) {
+	stages[stage].record(ns > 0 ? ns : 0);
+}
+
+void BenchStats::frame_done(timestamp done) {
+	n_frames++;
+	end = done;
+}
+
+static void merge_counts(std::vector<unsigned long long>& into, const std::vector<unsigned long long>& from) {
+	if (into.size() < from.size()) into.resize(from.size(), 0);
+	for (unsigned i = 0; i < from.size(); i++) into[i] += from[i];
+}
+
+void BenchStats::merge(const BenchStats& other) {
+	for (int i = 0; i < NUM_STAGES; i++) stages[i].merge(other.stages[i]);
+	merge_counts(detector.level_windows, other.detector.level_windows);
+	merge_counts(detector.stage_rejections, other.detector.stage_rejections);
+	detector.frames += other.detector.frames;
+	detector.windows += other.detector.windows;
+	detector.accepted += other.detector.accepted;
+	detector.features += other.detector.features;
+	detector.candidates += other.detector.candidates;
+	detector.candidates_max = std::max(detector.candidates_max, other.detector.candidates_max);
+
+	if (!n_frames) {
+		begin = other.begin;
+		end = other.end;
+	}
+	else if (other.n_frames) {
+		begin = std::min(begin, other.begin);
+		end = std::max(end, other.end);
+	}
+
+	n_frames += other.n_frames;
+	n_bytes += other.n_bytes;
+}
+
+double BenchStats::fps(void) const {
+	double seconds = std::chrono::duration<double>(end - begin).count();
+	return (seconds > 0) ? n_frames / seconds : 0.0;
+}
+
+static std::string json_string(const std::string& text) {
+	std::stringstream out;
+	out << '"';
+	for (unsigned i = 0; i < text.size(); i++) {
+		unsigned char c = text[i];
+		if (c == '"' || c == '\\') out << '\\' << c;
+		else if (c < 0x20) out << "\\u" << std::hex << std::setw(4) << std::setfill('0') << (int) c << std::dec;
+		else out << c;
+	}
+	out << '"';
+	return out.str();
+}
+
+static void print_counts(const std::vector<unsigned long long>& counts) {
+	std::cout << "[";
+	for (unsigned i = 0; i < counts.size(); i++) std::cout << (i ? "," : "") << counts[i];
+	std::cout << "]";
+}
+
+void print_bench(const std::vector<BenchStats>& streams, const std::vector<std::string>& names, bench_format format) {
+	BenchStats all;
+	for (unsigned i = 0; i < streams.size(); i++) all.merge(streams[i]);
+
+	const double percentiles[] = {0.50, 0.90, 0.99};
+
+	if (format == BENCH_JSON) {
+		std::cout << std::fixed << std::setprecision(3);
+		std::cout << "{\"streams\":[";
+		for (unsigned i = 0; i < streams.size(); i++) {
+			std::cout << (i ? "," : "") << "{\"name\":" << json_string(i < names.size() ? names[i] : "")
+				<< ",\"frames\":" << streams[i].frames() << ",\"fps\":" << streams[i].fps() << "}";
+		}
+		std::cout << "],\"frames\":" << all.frames() << ",\"fps\":" << all.fps()
+			<< ",\"bytes_per_frame\":" << all.bytes_per_frame() << ",\"stages\":{";
+
+		bool first = true;
+		for (int s = 0; s < NUM_STAGES; s++) {
+			const LatencyHistogram &h = all.stage((bench_stage) s);
+			if (!h.count()) continue;
+
+			std::cout << (first ? "" : ",") << "\"" << stage_names[s] << "\":{\"count\":" << h.count()
+				<< ",\"p50_ms\":" << h.percentile(percentiles[0]) / 1e6
+				<< ",\"p90_ms\":" << h.percentile(percentiles[1]) / 1e6
+				<< ",\"p99_ms\":" << h.percentile(percentiles[2]) / 1e6
+				<< ",\"max_ms\":" << h.max() / 1e6 << "}";
+			first = false;
+		}
+		std::cout << "}";
+
+		const cascade_work &work = all.cascade();
+		if (work.windows) {
+			std::cout << ",\"cascade\":{\"frames\":" << work.frames << ",\"windows\":" << work.windows
+				<< ",\"accepted\":" << work.accepted << ",\"features\":" << work.features
+				<< ",\"features_per_window\":" << work.features / (double) work.windows
+				<< ",\"candidates_per_frame\":" << (work.frames ? work.candidates / (double) work.frames : 0.0)
+				<< ",\"candidates_max\":" << work.candidates_max << ",\"level_windows\":";
+			print_counts(work.level_windows);
+			std::cout << ",\"stage_rejections\":";
+			print_counts(work.stage_rejections);
+			std::cout << "}";
+		}
+#ifdef WITH_PERF_COUNTERS
+		std::cout << ",\"perf\":";
+		print_perf_counters(std::cout, format);
+#endif
+		std::cout << "}" << std::endl;
+		return;
+	}
+
+	std::cout << std::left << std::setw(14) << "stage" << std::right
+		<< std::setw(10) << "frames"
+		<< std::setw(12) << "p50 ms"
+		<< std::setw(12) << "p90 ms"
+		<< std::setw(12) << "p99 ms"
+		<< std::setw(12) << "max ms" << std::endl;
+
+	std::cout << std::fixed << std::setprecision(3);
+	for (int s = 0; s < NUM_STAGES; s++) {
+		const LatencyHistogram &h = all.stage((bench_stage) s);
+		if (!h.count()) continue;
+
+		std::cout << std::left << std::setw(14) << stage_names[s] << std::right
+			<< std::setw(10) << h.count()
+			<< std::setw(12) << h.percentile(percentiles[0]) / 1e6
+			<< std::setw(12) << h.percentile(percentiles[1]) / 1e6
+			<< std::setw(12) << h.percentile(percentiles[2]) / 1e6
+			<< std::setw(12) << h.max() / 1e6 << std::endl;
+	}
+
+	std::cout << std::setprecision(2);
+	for (unsigned i = 0; i < streams.size(); i++) {
+		std::cout << "[" << (i < names.size() ? names[i] : "") << "] frames: " << streams[i].frames()
+			<< " fps: " << streams[i].fps() << std::endl;
+	}
+	std::cout << "system: " << streams.size() << " streams, " << all.frames() << " frames, "
+		<< all.fps() << " fps" << std::endl;
+	std::cout << "host memory written: " << all.bytes_per_frame() << " bytes/frame" << std::endl;
+
+	const cascade_work &work = all.cascade();
+	if (work.windows) {
+		std::cout << "cascade: " << work.windows << " windows, " << work.accepted << " accepted, "
+			<< work.features / (double) work.windows << " features/window, "
+			<< (work.frames ? work.candidates / (double) work.frames : 0.0) << " candidates/frame (max "
+			<< work.candidates_max << ")" << std::endl;
+
+		std::cout << "windows per level:";
+		for (unsigned i = 0; i < work.level_windows.size(); i++) {
+			if (work.level_windows[i]) std::cout << " " << i << ":" << work.level_windows[i];
+		}
+		std::cout << std::endl << "rejected per stage:";
+		for (unsigned i = 0; i < work.stage_rejections.size(); i++) {
+			if (work.stage_rejections[i]) std::cout << " " << i << ":" << work.stage_rejections[i];
+		}
+		std::cout << std::endl;
+	}
+
+#ifdef WITH_PERF_COUNTERS
+	print_perf_counters(std::cout, format);
+#endif
+}
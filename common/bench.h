@@ -0,0 +1,126 @@
+#ifndef BENCH
+#define BENCH
+
+/*===============================================================*/
+/*                                                               */
+/*                            bench.h                            */
+/*                                                               */
+/*             Per-stage latency histograms for --bench          */
+/*                                                               */
+/*===============================================================*/
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "frame_source.h"
+#include "options.h"
+
+// The steps a frame goes through. Targets only record the stages they have:
+// the CPU detector reports pyramid and cascade separately, the accelerator
+// reports them together as the time from submission to result.
+enum bench_stage {
+	STAGE_DECODE,
+	STAGE_PREPROCESS,
+	STAGE_PYRAMID,
+	STAGE_CASCADE,
+	STAGE_ACCELERATOR,
+	STAGE_GROUP,
+	STAGE_OUTPUT,
+	STAGE_TOTAL,	// decode start to result
+	NUM_STAGES
+};
+
+// Log-linear histogram of durations in nanoseconds. Every power of two is
+// split into 32 buckets, so percentiles are within about 3% of the truth
+// while the memory stays fixed however long the run is.
+class LatencyHistogram {
+public:
+	LatencyHistogram(void);
+
+	void record(unsigned long long ns);
+
+	void merge(const LatencyHistogram& other);
+
+	unsigned long long count(void) const { return n; }
+
+	unsigned long long max(void) const { return largest; }
+
+	// The value that a fraction `p` (0..1) of all records do not exceed,
+	// to bucket precision and never above the maximum.
+	unsigned long long percentile(double p) const;
+
+private:
+	static const int SUB_BUCKETS = 32;
+	static const int MAX_BIT = 40;	// about 18 minutes
+	static const int BUCKETS = 2 * SUB_BUCKETS + (MAX_BIT - 5) * SUB_BUCKETS;
+
+	static int bucket(unsigned long long ns);
+	static unsigned long long upper_bound(int bucket);
+
+	std::vector<unsigned long long> counts;
+	unsigned long long n;
+	unsigned long long largest;
+};
+
+// What the CPU cascade did for one stream, copied from the detector's own
+// per-thread counters (MyCascadeStats in sw/haar.h). Targets without such
+// counters leave it empty and the report skips it.
+typedef struct {
+	unsigned long long frames;
+	unsigned long long windows;
+	unsigned long long accepted;
+	unsigned long long features;
+	unsigned long long candidates;
+	unsigned long long candidates_max;
+	std::vector<unsigned long long> level_windows;
+	std::vector<unsigned long long> stage_rejections;
+} cascade_work;
+
+// Everything --bench measures for one stream. Each stage is recorded by a
+// single thread, so no locking is needed; read it once the stream is done.
+class BenchStats {
+public:
+	BenchStats(void);
+
+	// Call once before the first frame.
+	void start(void);
+
+	void record(bench_stage stage, std::chrono::steady_clock::duration d);
+
+	void record(bench_stage stage, long long ns);
+
+	// A frame has its result ready.
+	void frame_done(timestamp done);
+
+	// Host memory written on the way from decoded frame to detector input:
+	// conversions, intermediate images and copies.
+	void add_bytes(unsigned long long n) { n_bytes += n; }
+
+	void merge(const BenchStats& other);
+
+	unsigned long frames(void) const { return n_frames; }
+
+	double fps(void) const;
+
+	double bytes_per_frame(void) const { return n_frames ? n_bytes / (double) n_frames : 0.0; }
+
+	const LatencyHistogram& stage(bench_stage s) const { return stages[s]; }
+
+	void set_cascade(const cascade_work& work) { detector = work; }
+
+	const cascade_work& cascade(void) const { return detector; }
+
+private:
+	LatencyHistogram stages[NUM_STAGES];
+	cascade_work detector;
+	unsigned long n_frames;
+	unsigned long long n_bytes;
+	timestamp begin;
+	timestamp end;
+};
+
+// Print the merged stage latencies plus per-stream and system throughput.
+void print_bench(const std::vector<BenchStats>& streams, const std::vector<std::string>& names, bench_format format);
+
+#endif
@@ -0,0 +1,150 @@
+/*===============================================================*/
+/*                                                               */
+/*                      convert_frames.cpp                       */
+/*                                                               */
+/*     Any video to the raw gray or Y4M inputs of mapped replay  */
+/*                                                               */
+/*===============================================================*/
+
+// standard C/C++ headers
+#include <getopt.h>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+// required OpenCV headers
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/videoio.hpp>
+
+// other headers
+#include "mapped_source.h"
+
+typedef struct {
+	cv::Size size;	// 0x0 keeps the input size
+	long frames;	// 0 converts everything
+	std::string input;
+	std::string output;
+} convert_config;
+
+static void print_usage(char *filename) {
+	std::cout << "usage: " << filename << " <options> <input video> <output.gray|output.y4m>\n";
+	std::cout << "  -s, --size [WxH]        scale the frames (default: keep the input size)\n";
+	std::cout << "  -n, --frames [n]        convert at most n frames (default: all)\n";
+	std::cout << "  -h, --help              print this message\n";
+	std::cout << ".gray files hold the luma plane only, .y4m files 4:2:0 color.\n";
+}
+
+static void parse_args(int argc, char **argv, convert_config &config) {
+	static struct option long_options[] = {
+		{"size",          required_argument, 0, 's'},
+		{"frames",        required_argument, 0, 'n'},
+		{"help",          no_argument,       0, 'h'},
+		{0, 0, 0, 0}
+	};
+
+	config.size = cv::Size(0, 0);
+	config.frames = 0;
+
+	int c = 0;
+
+	while ((c = getopt_long(argc, argv, "s:n:h", long_options, NULL)) != -1) {
+		switch (c) {
+			case 's':
+				if (sscanf(optarg, "%dx%d", &config.size.width, &config.size.height) != 2 ||
+					config.size.width <= 0 || config.size.height <= 0) {
+					std::cerr << "Invalid frame size: " << optarg << std::endl;
+					exit(-1);
+				}
+				break;
+			case 'n':
+				config.frames = atol(optarg);
+				if (config.frames <= 0) {
+					std::cerr << "Invalid frame count: " << optarg << std::endl;
+					exit(-1);
+				}
+				break;
+			case 'h':
+				print_usage(argv[0]);
+				exit(0);
+			default: {
+				print_usage(argv[0]);
+				exit(-1);
+			}
+		} // matching on arguments
+	} // while args present
+
+	if (argc - optind != 2 || !is_mapped_input(argv[optind + 1])) {
+		print_usage(argv[0]);
+		exit(-1);
+	}
+
+	config.input = argv[optind];
+	config.output = argv[optind + 1];
+}
+
+int main(int argc, char ** argv) {
+	convert_config config;
+	parse_args(argc, argv, config);
+
+	cv::VideoCapture video(config.input);
+	if (!video.isOpened()) {
+		std::cerr << "Unable to open video file: " << config.input << std::endl;
+		return -1;
+	}
+
+	cv::Size size = config.size;
+	if (!size.area()) size = cv::Size(video.get(cv::CAP_PROP_FRAME_WIDTH), video.get(cv::CAP_PROP_FRAME_HEIGHT));
+
+	bool y4m = config.output.compare(config.output.size() - 4, 4, ".y4m") == 0;
+	if (y4m && (size.width % 2 || size.height % 2)) {
+		std::cerr << "4:2:0 needs an even frame size, not " << size.width << "x" << size.height << std::endl;
+		return -1;
+	}
+
+	std::ofstream out(config.output, std::ios::binary);
+	if (!out.is_open()) {
+		std::cerr << "Unable to open output file: " << config.output << std::endl;
+		return -1;
+	}
+
+	if (y4m) {
+		double fps = video.get(cv::CAP_PROP_FPS);
+		if (fps <= 0) fps = 30;
+
+		out << "YUV4MPEG2 W" << size.width << " H" << size.height
+			<< " F" << (long) std::round(fps * 1000) << ":1000 Ip A1:1 C420jpeg\n";
+	}
+
+	cv::Mat frame, scaled, converted;
+	long n = 0;
+
+	for (; !config.frames || n < config.frames; n++) {
+		if (!video.read(frame) || frame.empty()) break;
+
+		if (frame.size() != size) cv::resize(frame, scaled, size);
+		else scaled = frame;
+
+		if (y4m) {
+			cv::cvtColor(scaled, converted, cv::COLOR_BGR2YUV_I420);
+			out << "FRAME\n";
+		}
+		else cv::cvtColor(scaled, converted, cv::COLOR_BGR2GRAY);
+
+		out.write((const char *) converted.data, converted.total());
+	}
+
+	if (!out.good()) {
+		std::cerr << "Writing " << config.output << " failed" << std::endl;
+		return -1;
+	}
+
+	std::cout << config.output << ": " << n << " frames of " << size.width << "x" << size.height;
+	if (!y4m) std::cout << ", replay with --raw-size " << size.width << "x" << size.height;
+	std::cout << std::endl;
+
+	return 0;
+}
@@ -0,0 +1,142 @@
+/*===============================================================*/
+/*                                                               */
+/*                     detection_writer.cpp                      */
+/*                                                               */
+/*            Per-frame detection records, without video         */
+/*                                                               */
+/*===============================================================*/
+
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <time.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+#include "detection_writer.h"
+
+template <typename T>
+static void append(std::string& record, T value) {
+	record.append((const char *) &value, sizeof(value));
+}
+
+const std::chrono::milliseconds DetectionWriter::FLUSH_INTERVAL(100);
+
+DetectionWriter::DetectionWriter(const std::string& path, metadata_format format): format(format), failed(false) {
+	file = fopen(path.c_str(), (format == METADATA_BINARY) ? "wb" : "w");
+	// We do our own buffering.
+	if (file) setvbuf(file, NULL, _IONBF, 0);
+	buffer.reserve(BUFFER_SIZE);
+}
+
+DetectionWriter::~DetectionWriter(void) {
+	close();
+}
+
+void DetectionWriter::write(int stream, unsigned long frame, timestamp captured, int candidates, const std::vector<cv::Rect>& faces) {
+	if (!file) return;
+
+	// Steady clock for measuring, wall clock for the consumer.
+	int64_t ts = std::chrono::duration_cast<std::chrono::microseconds>(
+		(std::chrono::system_clock::now() - (std::chrono::steady_clock::now() - captured)).time_since_epoch()).count();
+
+	// Reused by every record this thread writes.
+	static thread_local std::string record;
+	record.clear();
+
+	if (format == METADATA_BINARY) {
+		append<uint32_t>(record, 0);
+		append<uint32_t>(record, stream);
+		append<uint32_t>(record, candidates);
+		append<uint64_t>(record, frame);
+		append<int64_t>(record, ts);
+		append<uint32_t>(record, faces.size());
+		for (unsigned i = 0; i < faces.size(); i++) {
+			append<int32_t>(record, faces[i].x);
+			append<int32_t>(record, faces[i].y);
+			append<int32_t>(record, faces[i].width);
+			append<int32_t>(record, faces[i].height);
+		}
+
+		uint32_t length = record.size() - sizeof(uint32_t);
+		record.replace(0, sizeof(length), (const char *) &length, sizeof(length));
+	}
+	else {
+		char field[128];
+
+		snprintf(field, sizeof(field), "{\"stream\":%d,\"frame\":%lu,\"ts\":%lld,\"candidates\":%d,\"faces\":[",
+			stream, frame, (long long) ts, candidates);
+		record += field;
+		for (unsigned i = 0; i < faces.size(); i++) {
+			snprintf(field, sizeof(field), "%s[%d,%d,%d,%d]", i ? "," : "",
+				faces[i].x, faces[i].y, faces[i].width, faces[i].height);
+			record += field;
+		}
+		record += "]}\n";
+	}
+
+	timestamp now = std::chrono::steady_clock::now();
+
+	std::lock_guard<std::mutex> lock(m);
+	if (failed) return;
+
+	if (buffer.size() + record.size() > BUFFER_SIZE) flush();
+	if (buffer.empty()) oldest = now;
+	buffer += record;
+
+	if (now - oldest >= FLUSH_INTERVAL) flush();
+}
+
+void DetectionWriter::poll(void) {
+	if (!file) return;
+
+	std::lock_guard<std::mutex> lock(m);
+	if (!buffer.empty() && std::chrono::steady_clock::now() - oldest >= FLUSH_INTERVAL) flush();
+}
+
+// A FIFO whose reader went away raises SIGPIPE, which would kill the process.
+// The signal is blocked for this thread only and one raised by the write is
+// consumed, so the write fails with EPIPE and the disposition of the signal,
+// which belongs to the application, stays as it is.
+static bool write_all(FILE *file, const std::string& data) {
+	sigset_t pipe, old, pending;
+	sigemptyset(&pipe);
+	sigaddset(&pipe, SIGPIPE);
+	pthread_sigmask(SIG_BLOCK, &pipe, &old);
+
+	// One pending already is not ours to take.
+	sigpending(&pending);
+	bool was_pending = sigismember(&pending, SIGPIPE);
+
+	bool written = fwrite(data.data(), 1, data.size(), file) == data.size();
+	int error = errno;
+
+	if (!written && error == EPIPE && !was_pending) {
+		struct timespec now = {0, 0};
+		while (sigtimedwait(&pipe, NULL, &now) < 0 && errno == EINTR) {}
+	}
+
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+	errno = error;
+	return written;
+}
+
+void DetectionWriter::flush(void) {
+	if (!buffer.empty() && !failed && !write_all(file, buffer)) {
+		std::cerr << "Unable to write metadata (" << strerror(errno) << "), dropping further records" << std::endl;
+		failed = true;
+	}
+	buffer.clear();
+}
+
+void DetectionWriter::close(void) {
+	std::lock_guard<std::mutex> lock(m);
+	if (!file) return;
+
+	flush();
+	fclose(file);
+	file = NULL;
+}
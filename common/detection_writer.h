@@ -0,0 +1,76 @@
+#ifndef DETECTION_WRITER
+#define DETECTION_WRITER
+
+/*===============================================================*/
+/*                                                               */
+/*                      detection_writer.h                       */
+/*                                                               */
+/*            Per-frame detection records, without video         */
+/*                                                               */
+/*===============================================================*/
+
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include "frame_source.h"
+#include "options.h"
+
+// Writes one record per processed frame to a file or FIFO, shared by all
+// streams. Records are built in a local buffer and appended under a lock to a
+// large output buffer, which is flushed with a single fwrite when full, or
+// once its oldest record is FLUSH_INTERVAL old so a reader is never far
+// behind. If a write fails, e.g. the FIFO's reader went away, the error is
+// reported once and later records are dropped. The SIGPIPE of such a write is
+// kept from the process without touching how the process handles it.
+//
+// JSON Lines:
+//   {"stream":0,"frame":12,"ts":1700000000123456,"candidates":37,"faces":[[x,y,w,h],...]}
+//
+// Binary, native byte order, every record:
+//   uint32 length      bytes that follow this field
+//   uint32 stream
+//   uint32 candidates  detector hits before grouping
+//   uint64 frame
+//   int64  ts          capture time, microseconds since the UNIX epoch
+//   uint32 count
+//   int32  x, y, w, h  `count` times
+//
+// Faces are in pixels of the decoded frame, whatever size it was detected at.
+class DetectionWriter {
+public:
+	DetectionWriter(const std::string& path, metadata_format format);
+
+	~DetectionWriter(void);
+
+	bool isOpened(void) const { return file != NULL; }
+
+	void write(int stream, unsigned long frame, timestamp captured, int candidates, const std::vector<cv::Rect>& faces);
+
+	// Flush the buffer if its oldest record is due; called by the
+	// dispatchers on every pass, so records go out even when no more come.
+	void poll(void);
+
+	// Flush what is buffered and close the file. Called by the destructor.
+	void close(void);
+
+private:
+	static const size_t BUFFER_SIZE = 1 << 16;
+	static const std::chrono::milliseconds FLUSH_INTERVAL;
+
+	void flush(void);
+
+	FILE *file;
+	metadata_format format;
+
+	std::mutex m;
+	std::string buffer;
+	timestamp oldest;	// when the first record in the buffer was added
+	bool failed;		// a write failed; records are dropped
+};
+
+#endif
@@ -0,0 +1,103 @@
+#ifndef DETECTOR
+#define DETECTOR
+
+/*===============================================================*/
+/*                                                               */
+/*                           detector.h                          */
+/*                                                               */
+/*       What the pipeline needs from a detection backend        */
+/*                                                               */
+/*===============================================================*/
+
+#include <functional>
+#include <future>
+#include <string>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include "bench.h"
+#include "frame_source.h"
+#include "haar.h"
+#include "options.h"
+
+// One frame on its way through a backend. The pipeline writes the gray image
+// into `input`, submits the job and, once `response` is ready and the job is
+// completed, reads `candidates`. `completed` is when the dispatcher first saw
+// the response ready, or zero before; a backend that submits the job again
+// resets it.
+typedef struct {
+	int stream;
+	long frame;
+	cv::Mat input;		// the stream's detection size, CV_8UC1, over the backend's buffer
+	std::future<void> response;
+	std::vector<MyRect> candidates;	// every window found, before grouping
+
+	// Filled in by the backend: where the frame ran, for --bench and the
+	// accelerator's latency, and how long the CPU cascade took.
+	bool on_cpu;
+	timestamp submitted;
+	timestamp completed;
+	long long pyramid_ns;
+	long long cascade_ns;
+
+	void *context;		// the backend's own buffers
+} detect_job;
+
+// The frames of one stream on a backend. The submitter thread submits, the
+// stream's dispatcher completes; attach and detach happen before and after.
+class StreamDetector {
+public:
+	virtual ~StreamDetector(void) {}
+
+	// Give the job the buffers it keeps for the life of the stream, among
+	// them the one `input` points to.
+	virtual void attach(detect_job *job) = 0;
+
+	virtual void detach(detect_job *job) = 0;
+
+	// Whether submit() may also be given a job whose `input` is a header over
+	// someone else's image, e.g. a frame in a mapping, so that a frame that
+	// already is the detector input is not copied. A backend that reads the
+	// input in place can; one that sends it from its own buffer cannot.
+	virtual bool borrows_input(void) const { return false; }
+
+	// Start detection on the job's input. Its response is ready once the
+	// results are, or the backend failed.
+	virtual void submit(detect_job *job) = 0;
+
+	// Collect the results of a job whose response is ready into its
+	// candidates. Returns false if the backend runs the job again instead,
+	// with a new response to wait for. Throws what the backend could not
+	// recover from, which ends the stream.
+	virtual bool complete(detect_job *job) = 0;
+
+	// What this stream did on the backend, once it is done.
+	virtual void print(const std::string& name) {}
+
+	// Add the backend's own measurements of this stream to --bench.
+	virtual void finish(BenchStats *bench) {}
+};
+
+// A way to run the cascade: the CPU (sw) or the accelerator (hw).
+class DetectorBackend {
+public:
+	virtual ~DetectorBackend(void) {}
+
+	// For the viewer's title.
+	virtual const char *name(void) const = 0;
+
+	// How many frames of a stream may be in flight, given `streams` of them.
+	virtual int depth(const app_options& options, int streams) const = 0;
+
+	// The detector for one stream, whose frames are `size`; the caller
+	// deletes it.
+	virtual StreamDetector *open(int stream, int depth, cv::Size size) = 0;
+};
+
+// Makes the backend for `streams` streams run at once; the caller deletes it.
+// Throws std::runtime_error if the backend cannot be set up, which fails the
+// run.
+typedef std::function<DetectorBackend *(int streams)> backend_factory;
+
+#endif
@@ -0,0 +1,66 @@
+#ifndef FRAME_POOL
+#define FRAME_POOL
+
+/*===============================================================*/
+/*                                                               */
+/*                         frame_pool.h                          */
+/*                                                               */
+/*            Recycled frame buffers handed between threads      */
+/*                                                               */
+/*===============================================================*/
+
+#include <mutex>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+// A free list of frames. Producers acquire a buffer, hand it down the
+// pipeline and whoever consumes it last gives it back, so in steady state no
+// frame memory is allocated.
+class FramePool {
+public:
+	FramePool(): n_allocations(0) {}
+
+	cv::Mat acquire(cv::Size size, int type) {
+		cv::Mat frame;
+		{
+			std::lock_guard<std::mutex> lock(m);
+			if (!frames.empty()) {
+				frame = std::move(frames.back());
+				frames.pop_back();
+			}
+		}
+
+		unsigned char *data = frame.data;
+		frame.create(size, type);
+		if (frame.data != data) n_allocations++;
+
+		return frame;
+	}
+
+	// Allocate `n` frames up front, e.g. as many as can be in flight.
+	void reserve(int n, cv::Size size, int type) {
+		for (int i = 0; i < n; i++) {
+			cv::Mat frame(size, type);
+			n_allocations++;
+			release(frame);
+		}
+	}
+
+	// The caller must hold the only reference to the frame.
+	void release(cv::Mat& frame) {
+		if (frame.empty()) return;
+
+		std::lock_guard<std::mutex> lock(m);
+		frames.push_back(std::move(frame));
+	}
+
+	unsigned long allocations(void) const { return n_allocations; }
+
+private:
+	std::vector<cv::Mat> frames;
+	std::mutex m;
+	unsigned long n_allocations;
+};
+
+#endif
@@ -0,0 +1,161 @@
+/*===============================================================*/
+/*                                                               */
+/*                       frame_source.cpp                        */
+/*                                                               */
+/*             Video input with optional live grabbing           */
+/*                                                               */
+/*===============================================================*/
+
+#include <cctype>
+#include <vector>
+
+#include "frame_source.h"
+#include "mapped_source.h"
+#include "trace.h"
+
+// Open and read timeouts for captures came with OpenCV 4.5.2.
+#if CV_VERSION_MAJOR > 4 || (CV_VERSION_MAJOR == 4 && (CV_VERSION_MINOR > 5 || (CV_VERSION_MINOR == 5 && CV_VERSION_REVISION >= 2)))
+#define HAVE_CAPTURE_TIMEOUTS
+#endif
+
+// A live source that delivers nothing for this long is taken as ended, so the
+// grabber is never stuck in a read and FrameSource::close never waits longer
+// than this for it. Backends without read timeouts ignore it.
+static const int LIVE_READ_TIMEOUT_MS = 3000;
+
+cv::VideoCapture *open_video(const std::string& name, const app_options& options) {
+	// Already raw frames; nothing for a decoder to do.
+	if (is_mapped_input(name)) {
+		return new MappedVideoCapture(name, cv::Size(options.raw_width, options.raw_height), options.loop);
+	}
+
+	bool index = !name.empty();
+	for (unsigned i = 0; i < name.size(); i++) {
+		if (!isdigit((unsigned char) name[i])) index = false;
+	}
+
+	cv::VideoCapture *video;
+#ifdef HAVE_CAPTURE_TIMEOUTS
+	// Most backends only take the timeouts when the capture is opened.
+	std::vector<int> params;
+	if (options.live) params = {cv::CAP_PROP_READ_TIMEOUT_MSEC, LIVE_READ_TIMEOUT_MS};
+
+	if (index) video = new cv::VideoCapture(std::stoi(name), cv::CAP_ANY, params);
+	else video = new cv::VideoCapture(name, cv::CAP_ANY, params);
+#else
+	if (index) video = new cv::VideoCapture(std::stoi(name));
+	else video = new cv::VideoCapture(name);
+#endif
+
+	if (!video->isOpened()) return video;
+
+	// Don't let the backend queue up frames behind our back.
+	if (options.live) video->set(cv::CAP_PROP_BUFFERSIZE, 1);
+
+	// Backends that can't hand out raw frames ignore this and keep
+	// decoding to BGR, which the Preprocessor still accepts.
+	if (options.luma) video->set(cv::CAP_PROP_CONVERT_RGB, false);
+
+	return video;
+}
+
+FrameSource::FrameSource(cv::VideoCapture& video, bool live, drop_policy policy, int stream):
+	video(video), live(live), policy(policy), stream(stream), decoded(0),
+	latest_decoding(0), decoding(0),
+	fresh(false), finished(false), stopped(false), n_dropped(0), n_allocations(0) {
+	if (live) grabber = std::thread(&FrameSource::grab, this);
+}
+
+FrameSource::~FrameSource(void) {
+	close();
+}
+
+void FrameSource::close(void) {
+	{
+		std::lock_guard<std::mutex> lock(m);
+		stopped = true;
+	}
+	c.notify_all();
+
+	if (grabber.joinable()) grabber.join();
+}
+
+bool FrameSource::read(cv::Mat& frame, timestamp& captured) {
+	if (!live) {
+		unsigned char *data = frame.data;
+		timestamp start = std::chrono::steady_clock::now();
+
+		if (!video.read(frame) || frame.empty()) return false;
+		captured = std::chrono::steady_clock::now();
+		decoding = captured - start;
+		trace_span("capture", stream, decoded++, start, captured);
+
+		// Frames over memory the capture owns (a mapping) were not allocated.
+		if (frame.data != data && frame.u) n_allocations++;
+		return true;
+	}
+
+	std::unique_lock<std::mutex> lock(m);
+	while (!fresh && !finished) c.wait(lock);
+
+	if (!fresh) return false;
+
+	// Our previous buffer goes back to the grabber for reuse.
+	cv::swap(frame, latest);
+	captured = latest_time;
+	decoding = latest_decoding;
+	fresh = false;
+
+	lock.unlock();
+	c.notify_all();
+	return true;
+}
+
+void FrameSource::grab(void) {
+	trace_thread("grabber " + std::to_string(stream));
+
+	while (true) {
+		unsigned char *data = back.data;
+		timestamp start = std::chrono::steady_clock::now();
+
+		bool ok = video.read(back) && !back.empty();
+		timestamp now = std::chrono::steady_clock::now();
+
+		if (ok && back.data != data && back.u) n_allocations++;
+		if (ok) trace_span("capture", stream, decoded++, start, now);
+
+		std::unique_lock<std::mutex> lock(m);
+		if (!ok || stopped) {
+			finished = true;
+			lock.unlock();
+			c.notify_all();
+			return;
+		}
+
+		if (policy == KEEP_ALL) {
+			while (fresh && !stopped) c.wait(lock);
+
+			// Nobody is going to take it.
+			if (stopped) {
+				finished = true;
+				lock.unlock();
+				c.notify_all();
+				return;
+			}
+		}
+		else if (fresh) {
+			// The detector never saw the previous frame.
+			n_dropped++;
+		}
+
+		// Publish the new frame; the stale or consumed one becomes the
+		// next decode target.
+		cv::swap(back, latest);
+		latest_time = now;
+		latest_decoding = now - start;
+		fresh = true;
+
+		lock.unlock();
+		c.notify_all();
+	}
+}
@@ -0,0 +1,91 @@
+#ifndef FRAME_SOURCE
+#define FRAME_SOURCE
+
+/*===============================================================*/
+/*                                                               */
+/*                        frame_source.h                         */
+/*                                                               */
+/*             Video input with optional live grabbing           */
+/*                                                               */
+/*===============================================================*/
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <opencv2/videoio.hpp>
+
+#include "options.h"
+
+typedef std::chrono::steady_clock::time_point timestamp;
+
+// Open a video file, stream URL, camera index ("0", "1", ...) or a raw
+// gray or Y4M file (see mapped_source.h). The caller owns the capture and
+// checks isOpened(). With --live, reads that get no frame for a few seconds
+// fail, which ends the stream, where the backend supports read timeouts.
+cv::VideoCapture *open_video(const std::string& name, const app_options& options);
+
+// Reads frames from a cv::VideoCapture.
+//
+// For files every frame is decoded in order on the calling thread. In live
+// mode a dedicated grab thread keeps decoding as fast as the source delivers
+// and only the newest frame is kept for the consumer (DROP_STALE), or the
+// grabber waits for the consumer to take each frame (KEEP_ALL).
+//
+// Frame buffers are swapped, never copied: the caller should pass the same
+// cv::Mat to every read() and not keep other references to it, so decoding
+// reuses the same few buffers for the whole stream.
+class FrameSource {
+public:
+	// `stream` only labels the decode spans of --trace.
+	FrameSource(cv::VideoCapture& video, bool live, drop_policy policy, int stream = -1);
+
+	~FrameSource(void);
+
+	// Get the next frame and the time it was captured.
+	// Returns false once the input is exhausted.
+	bool read(cv::Mat& frame, timestamp& captured);
+
+	// Stop the grab thread (if any), which publishes no more frames. Waits
+	// for the read it is in, which live captures time out (see open_video).
+	// Called by the destructor.
+	void close(void);
+
+	// Time it took to decode the frame last returned by read().
+	std::chrono::steady_clock::duration decode_time(void) const { return decoding; }
+
+	unsigned long dropped(void) const { return n_dropped; }
+
+	// Times a frame buffer had to be (re)allocated.
+	unsigned long allocations(void) const { return n_allocations; }
+
+private:
+	void grab(void);
+
+	cv::VideoCapture& video;
+	bool live;
+	drop_policy policy;
+	int stream;
+	long decoded;	// frames decoded so far
+
+	std::thread grabber;
+	std::mutex m;
+	std::condition_variable c;
+
+	cv::Mat back;
+	cv::Mat latest;
+	timestamp latest_time;
+	std::chrono::steady_clock::duration latest_decoding;
+	std::chrono::steady_clock::duration decoding;
+	bool fresh;
+	bool finished;
+	bool stopped;
+
+	std::atomic<unsigned long> n_dropped;
+	std::atomic<unsigned long> n_allocations;
+};
+
+#endif
@@ -0,0 +1,50 @@
+/*===============================================================*/
+/*                                                               */
+/*                          job_pool.cpp                         */
+/*                                                               */
+/*          Recycled detector jobs for frames in flight          */
+/*                                                               */
+/*===============================================================*/
+
+#include "job_pool.h"
+
+JobPool::JobPool(StreamDetector *detector, int stream, int size): detector(detector), free(size) {
+	for (int i = 0; i < size; i++) {
+		detect_job *job = new detect_job;
+		job->stream = stream;
+		job->frame = -1;
+		job->on_cpu = false;
+		job->pyramid_ns = 0;
+		job->cascade_ns = 0;
+		job->context = NULL;
+		detector->attach(job);
+
+		jobs.push_back(job);
+		free.enqueue(job);
+	}
+}
+
+JobPool::~JobPool(void) {
+	for (unsigned i = 0; i < jobs.size(); i++) {
+		detector->detach(jobs[i]);
+		delete jobs[i];
+	}
+}
+
+void JobPool::monitor(const std::string& name) {
+	free.monitor(name);
+}
+
+detect_job *JobPool::acquire(void) {
+	return free.dequeue();
+}
+
+void JobPool::release(detect_job *job) {
+	// Keeps its capacity, so the next frame does not allocate.
+	job->candidates.clear();
+	job->on_cpu = false;
+	job->pyramid_ns = 0;
+	job->cascade_ns = 0;
+
+	free.enqueue(job);
+}
@@ -0,0 +1,46 @@
+#ifndef JOB_POOL
+#define JOB_POOL
+
+/*===============================================================*/
+/*                                                               */
+/*                           job_pool.h                          */
+/*                                                               */
+/*          Recycled detector jobs for frames in flight          */
+/*                                                               */
+/*===============================================================*/
+
+#include <string>
+#include <vector>
+
+#include "detector.h"
+#include "safe_queue.h"
+
+// A fixed number of jobs per stream, with the backend's buffers attached
+// once. The submitter takes a free job for every frame and the dispatcher
+// gives it back once the results are used, so the pool size bounds the
+// frames in flight and steady-state operation neither allocates nor
+// registers buffers.
+class JobPool {
+public:
+	JobPool(StreamDetector *detector, int stream, int size);
+
+	~JobPool(void);
+
+	// Publish the free jobs as queue `name` (see queue_stats.h); a pool that
+	// stays empty means the backend is the bottleneck.
+	void monitor(const std::string& name);
+
+	int size(void) const { return jobs.size(); }
+
+	// Wait until a job is free.
+	detect_job *acquire(void);
+
+	void release(detect_job *job);
+
+private:
+	StreamDetector *detector;
+	std::vector<detect_job*> jobs;
+	SafeQueue<detect_job*> free;
+};
+
+#endif
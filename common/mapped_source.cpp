@@ -0,0 +1,185 @@
+/*===============================================================*/
+/*                                                               */
+/*                       mapped_source.cpp                       */
+/*                                                               */
+/*          Raw gray and Y4M input replayed from a mapping       */
+/*                                                               */
+/*===============================================================*/
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+#include "mapped_source.h"
+
+static bool has_suffix(const std::string& name, const std::string& suffix) {
+	return name.size() > suffix.size() && name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+bool is_mapped_input(const std::string& name) {
+	return has_suffix(name, ".gray") || has_suffix(name, ".y4m");
+}
+
+MappedVideoCapture::MappedVideoCapture(const std::string& filename, cv::Size raw_size, long loop):
+	map(NULL), length(0), size(raw_size), fourcc(cv::VideoWriter::fourcc('G','R','E','Y')), fps(30),
+	frame_bytes(0), loop(loop), position(0), current(NULL) {
+	int fd = ::open(filename.c_str(), O_RDONLY);
+	if (fd < 0) return;
+
+	struct stat info;
+	if (fstat(fd, &info) < 0 || info.st_size <= 0) {
+		::close(fd);
+		return;
+	}
+
+	length = info.st_size;
+	void *address = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+
+	if (address == MAP_FAILED) return;
+	map = (unsigned char *) address;
+
+	// Frames are read front to back, and again on every loop.
+	madvise(map, length, MADV_SEQUENTIAL);
+
+	bool ok;
+	if (has_suffix(filename, ".y4m")) ok = parse_y4m();
+	else {
+		frame_bytes = (size_t) size.width * size.height;
+		ok = frame_bytes > 0;
+		for (size_t offset = 0; ok && offset + frame_bytes <= length; offset += frame_bytes) frames.push_back(offset);
+	}
+
+	if (!ok || frames.empty()) {
+		std::cerr << "No frames in " << filename << std::endl;
+		release();
+	}
+}
+
+MappedVideoCapture::~MappedVideoCapture(void) {
+	release();
+}
+
+// The stream header is "YUV4MPEG2" and space separated parameters, each frame
+// "FRAME" and optional parameters, both ended by a line feed.
+bool MappedVideoCapture::parse_y4m(void) {
+	const char *text = (const char *) map;
+	const char *end = (const char *) memchr(text, '\n', length);
+
+	if (length < 10 || memcmp(text, "YUV4MPEG2 ", 10) || !end) return false;
+
+	std::istringstream header(std::string(text + 10, end));
+	std::string colorspace = "420jpeg";
+	std::string token;
+
+	size = cv::Size(0, 0);
+	while (header >> token) {
+		switch (token[0]) {
+			case 'W': size.width = atoi(token.c_str() + 1); break;
+			case 'H': size.height = atoi(token.c_str() + 1); break;
+			case 'C': colorspace = token.substr(1); break;
+			case 'F': {
+				int num = 0, den = 0;
+				if (sscanf(token.c_str() + 1, "%d:%d", &num, &den) == 2 && num > 0 && den > 0) fps = num / (double) den;
+				break;
+			}
+			default: break;	// interlacing, aspect ratio and extensions
+		}
+	}
+
+	if (size.width <= 0 || size.height <= 0) return false;
+
+	if (colorspace == "mono") {
+		frame_bytes = (size_t) size.width * size.height;
+	}
+	else if (colorspace.compare(0, 3, "420") == 0 && size.width % 2 == 0 && size.height % 2 == 0) {
+		// Y, then Cb and Cr at half resolution: the I420 layout.
+		fourcc = cv::VideoWriter::fourcc('I','4','2','0');
+		frame_bytes = (size_t) size.width * size.height * 3 / 2;
+	}
+	else {
+		std::cerr << "Unsupported Y4M colorspace C" << colorspace << " (use 420 or mono)" << std::endl;
+		return false;
+	}
+
+	// Index every frame once, so reading is a lookup.
+	size_t offset = end + 1 - text;
+	while (offset + 5 <= length && !memcmp(text + offset, "FRAME", 5)) {
+		const char *line_end = (const char *) memchr(text + offset, '\n', length - offset);
+		if (!line_end) break;
+
+		size_t data = line_end + 1 - text;
+		if (data + frame_bytes > length) break;
+
+		frames.push_back(data);
+		offset = data + frame_bytes;
+	}
+
+	return true;
+}
+
+bool MappedVideoCapture::isOpened(void) const {
+	return map != NULL;
+}
+
+void MappedVideoCapture::release(void) {
+	if (map) munmap(map, length);
+
+	map = NULL;
+	current = NULL;
+	frames.clear();
+}
+
+bool MappedVideoCapture::grab(void) {
+	current = NULL;
+	if (!map) return false;
+
+	if (loop > 0) {
+		if (position >= loop) return false;
+	}
+	else if (position >= (long) frames.size()) return false;
+
+	current = map + frames[position % frames.size()];
+	position++;
+	return true;
+}
+
+bool MappedVideoCapture::retrieve(cv::OutputArray image, int flag) {
+	if (!current) return false;
+
+	int rows = (fourcc == cv::VideoWriter::fourcc('I','4','2','0')) ? size.height * 3 / 2 : size.height;
+
+	// A header over the mapping; the pixels are never touched here.
+	image.assign(cv::Mat(rows, size.width, CV_8UC1, current));
+	return true;
+}
+
+bool MappedVideoCapture::read(cv::OutputArray image) {
+	if (grab()) return retrieve(image);
+
+	image.release();
+	return false;
+}
+
+double MappedVideoCapture::get(int prop) const {
+	switch (prop) {
+		case cv::CAP_PROP_FRAME_WIDTH: return size.width;
+		case cv::CAP_PROP_FRAME_HEIGHT: return size.height;
+		case cv::CAP_PROP_FPS: return fps;
+		case cv::CAP_PROP_FOURCC: return fourcc;
+		case cv::CAP_PROP_FRAME_COUNT: return (loop > 0) ? loop : frames.size();
+		case cv::CAP_PROP_POS_FRAMES: return position;
+		default: return 0;
+	}
+}
+
+bool MappedVideoCapture::set(int prop, double value) {
+	return false;
+}
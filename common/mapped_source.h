@@ -0,0 +1,74 @@
+#ifndef MAPPED_SOURCE
+#define MAPPED_SOURCE
+
+/*===============================================================*/
+/*                                                               */
+/*                        mapped_source.h                        */
+/*                                                               */
+/*          Raw gray and Y4M input replayed from a mapping       */
+/*                                                               */
+/*===============================================================*/
+
+#include <string>
+#include <vector>
+
+#include <opencv2/videoio.hpp>
+
+// Inputs this reader takes instead of a decoder: ".gray" files of raw 8-bit
+// frames of a fixed size, back to back, and ".y4m" (YUV4MPEG2) files.
+bool is_mapped_input(const std::string& name);
+
+// Plays a raw gray or Y4M file from a read-only memory mapping, so benchmark
+// runs do not depend on the codecs and containers of the OpenCV build.
+//
+// Nothing is decoded or copied: read() hands out a cv::Mat that points into
+// the mapping, either the plain luma plane (gray, Y4M mono) or a whole I420
+// frame (Y4M 4:2:0), which the Preprocessor takes as is. Such a frame stays
+// valid until the capture is released. At the detection size its luma plane
+// goes to a backend that reads its input in place (the CPU) as it is; the
+// accelerator still gets a copy, as it can only send its own input buffer to
+// the device. With `loop` > 0 the file is replayed
+// from the start until exactly that many frames have been read.
+class MappedVideoCapture : public cv::VideoCapture {
+public:
+	// `raw_size` is the frame size of ".gray" files; Y4M files carry theirs.
+	MappedVideoCapture(const std::string& filename, cv::Size raw_size, long loop);
+
+	virtual ~MappedVideoCapture(void);
+
+	virtual bool isOpened(void) const;
+
+	virtual void release(void);
+
+	virtual bool grab(void);
+
+	virtual bool retrieve(cv::OutputArray image, int flag = 0);
+
+	virtual bool read(cv::OutputArray image);
+
+	// Width, height, FPS, FOURCC (I420 or GREY), frame count and position.
+	virtual double get(int prop) const;
+
+	// Nothing can be changed, so this always fails.
+	virtual bool set(int prop, double value);
+
+private:
+	bool parse_y4m(void);
+
+	unsigned char *map;
+	size_t length;
+
+	cv::Size size;
+	int fourcc;
+	double fps;
+	size_t frame_bytes;	// pixel data of one frame
+
+	// Offset of the pixel data of every frame in the file.
+	std::vector<size_t> frames;
+
+	long loop;
+	long position;		// frames grabbed so far, over all loops
+	unsigned char *current;	// data of the last grabbed frame
+};
+
+#endif
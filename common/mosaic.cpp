@@ -0,0 +1,45 @@
+/*===============================================================*/
+/*                                                               */
+/*                          mosaic.cpp                           */
+/*                                                               */
+/*               Persistent tiled canvas for the viewer          */
+/*                                                               */
+/*===============================================================*/
+
+#include <algorithm>
+#include <cmath>
+
+#include <opencv2/imgproc.hpp>
+
+#include "mosaic.h"
+
+Mosaic::Mosaic(int tiles, cv::Size tile, cv::Size max_size) {
+	tiles = std::max(tiles, 1);
+	columns = ceil(sqrt(tiles));
+	int rows = ceil(tiles / (float) columns);
+
+	double scale = std::min(1.0, std::min(max_size.width / (double) (columns * tile.width),
+		(max_size.height - STATUS_HEIGHT) / (double) (rows * tile.height)));
+
+	tile_size = cv::Size(std::max(1, (int) (tile.width * scale)), std::max(1, (int) (tile.height * scale)));
+
+	output = cv::Mat::zeros(cv::Size(columns * tile_size.width, STATUS_HEIGHT + rows * tile_size.height), CV_8UC3);
+}
+
+void Mosaic::update(int tile, const cv::Mat& frame) {
+	cv::Rect rect((tile % columns) * tile_size.width, STATUS_HEIGHT + (tile / columns) * tile_size.height,
+		tile_size.width, tile_size.height);
+	cv::Mat roi = output(rect);
+
+	if (frame.size() == tile_size) frame.copyTo(roi);
+	else cv::resize(frame, roi, tile_size, 0, 0, cv::INTER_AREA);
+}
+
+void Mosaic::set_status(const std::string& text) {
+	cv::Mat bar = output(cv::Rect(0, 0, output.cols, STATUS_HEIGHT));
+	bar.setTo(cv::Scalar(0, 0, 0));
+
+	if (!text.empty()) {
+		cv::putText(bar, text, cv::Point(std::max(0, bar.cols - 250), bar.rows - 10), cv::FONT_HERSHEY_COMPLEX_SMALL, 0.8, cv::Scalar(0,255,0), 1, cv::LINE_AA);
+	}
+}
@@ -0,0 +1,38 @@
+#ifndef MOSAIC
+#define MOSAIC
+
+/*===============================================================*/
+/*                                                               */
+/*                           mosaic.h                            */
+/*                                                               */
+/*               Persistent tiled canvas for the viewer          */
+/*                                                               */
+/*===============================================================*/
+
+#include <string>
+
+#include <opencv2/core.hpp>
+
+// A grid of one tile per stream plus a status bar on top, allocated once.
+// New frames are copied (or shrunk) into their tile, so the cost of an update
+// is one tile, not the whole mosaic.
+class Mosaic {
+public:
+	// Tiles shrink below `tile` when the grid would not fit in `max_size`.
+	Mosaic(int tiles, cv::Size tile, cv::Size max_size = cv::Size(1920, 1080));
+
+	void update(int tile, const cv::Mat& frame);
+
+	void set_status(const std::string& text);
+
+	const cv::Mat& canvas(void) const { return output; }
+
+private:
+	static const int STATUS_HEIGHT = 30;
+
+	int columns;
+	cv::Size tile_size;
+	cv::Mat output;
+};
+
+#endif
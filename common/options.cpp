@@ -0,0 +1,291 @@
+/*===============================================================*/
+/*                                                               */
+/*                         options.cpp                           */
+/*                                                               */
+/*                   Command line configuration                  */
+/*                                                               */
+/*===============================================================*/
+
+#include <getopt.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include "options.h"
+
+void print_usage(char* filename) {
+	std::cout << "usage: " << filename << " <options> <videos or cameras...>\n";
+	std::cout << "  -l, --live              treat inputs as live sources (cameras, RTSP)\n";
+	std::cout << "  -p, --policy [latest|all]\n";
+	std::cout << "                          live mode only: process the newest frame and drop\n";
+	std::cout << "                          stale ones (latest, default) or every frame (all)\n";
+	std::cout << "  -y, --luma              ask the decoder for raw YUV and detect on its luma plane,\n";
+	std::cout << "                          skipping the conversion to BGR where possible\n";
+	std::cout << "  -r, --refresh-rate [Hz] how often the viewer redraws the screen (default 30)\n";
+	std::cout << "  -o, --output-dir [dir]  where save mode writes its videos (default .)\n";
+	std::cout << "  -m, --metadata [json|binary]\n";
+	std::cout << "                          headless: write per-frame detections as JSON Lines or\n";
+	std::cout << "                          binary records instead of showing or encoding video\n";
+	std::cout << "  -f, --metadata-file [path]\n";
+	std::cout << "                          file or FIFO for --metadata (default detections.jsonl\n";
+	std::cout << "                          or detections.bin)\n";
+	std::cout << "  -b, --bench[=table|json]\n";
+	std::cout << "                          headless: time every pipeline stage and print\n";
+	std::cout << "                          throughput and latency percentiles on exit\n";
+	std::cout << "  -s, --scale [max]       headless: replay the inputs as 1..max concurrent streams\n";
+	std::cout << "                          and write one CSV row of throughput, CPU and latency\n";
+	std::cout << "                          per stream count\n";
+	std::cout << "      --scale-file [path] where --scale writes its CSV (default scaling.csv)\n";
+	std::cout << "      --raw-size [WxH]    frame size of .gray inputs (default 320x240)\n";
+	std::cout << "      --detect-size [WxH,...]\n";
+	std::cout << "                          resolution each input is detected at, in input order;\n";
+	std::cout << "                          the last one holds for the rest (default 320x240);\n";
+	std::cout << "                          annotated video is drawn at it, --metadata is in\n";
+	std::cout << "                          source pixels\n";
+	std::cout << "      --loop [frames]     replay .gray and .y4m inputs until this many frames\n";
+	std::cout << "                          were read (default: play once)\n";
+	std::cout << "      --dispatchers [n]   threads that complete the frames of all streams\n";
+	std::cout << "                          (default: one per 8 streams)\n";
+	std::cout << "      --max-inflight [n]  most frames a stream keeps in detection. hw: the limit\n";
+	std::cout << "                          adapts below it (default 64, 4 for --live latest);\n";
+	std::cout << "                          sw: default enough for its share of the CPU workers\n";
+	std::cout << "      --latency-target [ms]\n";
+	std::cout << "                          hw: keep submit-to-result latency under this (default none)\n";
+	std::cout << "      --cpu-workers [n]   threads running the software cascade. sw: shared by all\n";
+	std::cout << "                          streams (default one per stream); hw: for frames the\n";
+	std::cout << "                          accelerator cannot take (default 0, accelerator only)\n";
+	std::cout << "      --spill-latency [ms]\n";
+	std::cout << "                          hw: also send frames to the CPU threads while accelerator\n";
+	std::cout << "                          latency is above this (default: only at the in-flight limit)\n";
+	std::cout << "      --trace [path]      record when every frame entered and left each stage and\n";
+	std::cout << "                          write it on exit as Chrome Trace Event JSON (Perfetto)\n";
+	std::cout << "      --telemetry [path|unix:path]\n";
+	std::cout << "                          export queue depth and stall times in Prometheus text\n";
+	std::cout << "                          format, rewriting a file or answering on a UNIX socket\n";
+	std::cout << "      --telemetry-interval [ms]\n";
+	std::cout << "                          how often the telemetry file is rewritten (default 1000)\n";
+	std::cout << "  -h, --help              print this message\n";
+}
+
+void parse_command_line_args(int argc, char** argv, app_options& options) {
+	static struct option long_options[] = {
+		{"live",          no_argument,       0, 'l'},
+		{"policy",        required_argument, 0, 'p'},
+		{"luma",          no_argument,       0, 'y'},
+		{"refresh-rate",  required_argument, 0, 'r'},
+		{"output-dir",    required_argument, 0, 'o'},
+		{"metadata",      required_argument, 0, 'm'},
+		{"metadata-file", required_argument, 0, 'f'},
+		{"bench",         optional_argument, 0, 'b'},
+		{"scale",         required_argument, 0, 's'},
+		{"scale-file",    required_argument, 0, 'S'},
+		{"trace",         required_argument, 0, 'T'},
+		{"telemetry",     required_argument, 0, 'E'},
+		{"telemetry-interval", required_argument, 0, 'I'},
+		{"raw-size",      required_argument, 0, 'R'},
+		{"detect-size",   required_argument, 0, 'Z'},
+		{"loop",          required_argument, 0, 'L'},
+		{"dispatchers",   required_argument, 0, 'D'},
+		{"max-inflight",  required_argument, 0, 'Q'},
+		{"latency-target", required_argument, 0, 'A'},
+		{"cpu-workers",   required_argument, 0, 'W'},
+		{"spill-latency", required_argument, 0, 'P'},
+		{"help",          no_argument,       0, 'h'},
+		{0, 0, 0, 0}
+	};
+
+	options.live = false;
+	options.policy = DROP_STALE;
+	options.luma = false;
+	options.refresh_rate = 30;
+	options.output_dir = ".";
+	options.metadata = METADATA_NONE;
+	options.metadata_file = "";
+	options.bench = BENCH_NONE;
+	options.scale = 0;
+	options.scale_file = "scaling.csv";
+	options.trace_file = "";
+	options.telemetry = "";
+	options.telemetry_interval = 1000;
+	options.raw_width = 320;
+	options.raw_height = 240;
+	options.loop = 0;
+	options.dispatchers = 0;
+	options.max_inflight = 0;
+	options.latency_target = 0;
+	options.cpu_workers = 0;
+	options.spill_latency = 0;
+	options.detect_sizes.clear();
+	options.inputs.clear();
+
+	int c = 0;
+
+	while ((c = getopt_long(argc, argv, "lp:yr:o:m:f:b::s:h", long_options, NULL)) != -1) {
+		switch (c) {
+			case 'l':
+				options.live = true;
+				break;
+			case 'p':
+				if (!strcmp(optarg, "latest")) options.policy = DROP_STALE;
+				else if (!strcmp(optarg, "all")) options.policy = KEEP_ALL;
+				else {
+					std::cerr << "Unknown drop policy: " << optarg << std::endl;
+					print_usage(argv[0]);
+					exit(-1);
+				}
+				break;
+			case 'y':
+				options.luma = true;
+				break;
+			case 'r':
+				options.refresh_rate = atoi(optarg);
+				if (options.refresh_rate <= 0) {
+					std::cerr << "Invalid refresh rate: " << optarg << std::endl;
+					exit(-1);
+				}
+				break;
+			case 'o':
+				options.output_dir = optarg;
+				break;
+			case 'm':
+				if (!strcmp(optarg, "json")) options.metadata = METADATA_JSON;
+				else if (!strcmp(optarg, "binary")) options.metadata = METADATA_BINARY;
+				else {
+					std::cerr << "Unknown metadata format: " << optarg << std::endl;
+					print_usage(argv[0]);
+					exit(-1);
+				}
+				break;
+			case 'f':
+				options.metadata_file = optarg;
+				break;
+			case 'b':
+				if (!optarg || !strcmp(optarg, "table")) options.bench = BENCH_TABLE;
+				else if (!strcmp(optarg, "json")) options.bench = BENCH_JSON;
+				else {
+					std::cerr << "Unknown bench format: " << optarg << std::endl;
+					print_usage(argv[0]);
+					exit(-1);
+				}
+				break;
+			case 's':
+				options.scale = atoi(optarg);
+				if (options.scale <= 0) {
+					std::cerr << "Invalid stream count: " << optarg << std::endl;
+					exit(-1);
+				}
+				break;
+			case 'S':
+				options.scale_file = optarg;
+				break;
+			case 'T':
+				options.trace_file = optarg;
+				break;
+			case 'E':
+				options.telemetry = optarg;
+				break;
+			case 'I':
+				options.telemetry_interval = atoi(optarg);
+				if (options.telemetry_interval <= 0) {
+					std::cerr << "Invalid telemetry interval: " << optarg << std::endl;
+					exit(-1);
+				}
+				break;
+			case 'R':
+				if (sscanf(optarg, "%dx%d", &options.raw_width, &options.raw_height) != 2 ||
+					options.raw_width <= 0 || options.raw_height <= 0) {
+					std::cerr << "Invalid raw frame size: " << optarg << std::endl;
+					exit(-1);
+				}
+				break;
+			case 'Z': {
+				// Smaller than the classifier's 24x24 window nothing is found.
+				options.detect_sizes.clear();
+				for (const char *size = optarg; size; size = strchr(size, ',')) {
+					if (*size == ',') size++;
+
+					frame_size detect;
+					if (sscanf(size, "%dx%d", &detect.width, &detect.height) != 2 ||
+						detect.width < 24 || detect.height < 24) {
+						std::cerr << "Invalid detection size: " << optarg << std::endl;
+						exit(-1);
+					}
+					options.detect_sizes.push_back(detect);
+				}
+				break;
+			}
+			case 'L':
+				options.loop = atol(optarg);
+				if (options.loop <= 0) {
+					std::cerr << "Invalid loop length: " << optarg << std::endl;
+					exit(-1);
+				}
+				break;
+			case 'D':
+				options.dispatchers = atoi(optarg);
+				if (options.dispatchers <= 0) {
+					std::cerr << "Invalid dispatcher count: " << optarg << std::endl;
+					exit(-1);
+				}
+				break;
+			case 'Q':
+				options.max_inflight = atoi(optarg);
+				if (options.max_inflight <= 0) {
+					std::cerr << "Invalid in-flight limit: " << optarg << std::endl;
+					exit(-1);
+				}
+				break;
+			case 'A':
+				options.latency_target = atof(optarg);
+				if (options.latency_target <= 0) {
+					std::cerr << "Invalid latency target: " << optarg << std::endl;
+					exit(-1);
+				}
+				break;
+			case 'W':
+				options.cpu_workers = atoi(optarg);
+				if (options.cpu_workers < 0) {
+					std::cerr << "Invalid CPU worker count: " << optarg << std::endl;
+					exit(-1);
+				}
+				break;
+			case 'P':
+				options.spill_latency = atof(optarg);
+				if (options.spill_latency <= 0) {
+					std::cerr << "Invalid spill latency: " << optarg << std::endl;
+					exit(-1);
+				}
+				break;
+			case 'h':
+				print_usage(argv[0]);
+				exit(0);
+			default: {
+				print_usage(argv[0]);
+				exit(-1);
+			}
+		} // matching on arguments
+	} // while args present
+
+	if (options.metadata != METADATA_NONE && options.metadata_file.empty()) {
+		options.metadata_file = (options.metadata == METADATA_JSON) ? "detections.jsonl" : "detections.bin";
+	}
+
+	for (int i = optind; i < argc; i++) {
+		options.inputs.push_back(argv[i]);
+	}
+}
+
+frame_size detect_size(const app_options& options, int input) {
+	if (options.detect_sizes.empty()) {
+		frame_size size = {320, 240};
+		return size;
+	}
+	return options.detect_sizes[std::min(input, (int) options.detect_sizes.size() - 1)];
+}
+
+bool is_headless(const app_options& options) {
+	return options.metadata != METADATA_NONE || options.bench != BENCH_NONE || options.scale > 0;
+}
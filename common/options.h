@@ -0,0 +1,77 @@
+#ifndef OPTIONS
+#define OPTIONS
+
+/*===============================================================*/
+/*                                                               */
+/*                          options.h                            */
+/*                                                               */
+/*                   Command line configuration                  */
+/*                                                               */
+/*===============================================================*/
+
+#include <string>
+#include <vector>
+
+// What a live source does when the detector falls behind.
+enum drop_policy {
+	DROP_STALE,	// keep only the newest frame, latency stays bounded
+	KEEP_ALL	// process every frame, latency may grow
+};
+
+// What to produce besides the video window or files.
+enum metadata_format {
+	METADATA_NONE,	// annotated video output as usual
+	METADATA_JSON,	// headless, one JSON object per frame and line
+	METADATA_BINARY	// headless, length-prefixed binary records
+};
+
+// How --bench reports its measurements.
+enum bench_format {
+	BENCH_NONE,	// no benchmark
+	BENCH_TABLE,	// headless, human readable table on exit
+	BENCH_JSON	// headless, one JSON object on exit
+};
+
+// Width and height of a frame, in pixels.
+typedef struct {
+	int width;
+	int height;
+} frame_size;
+
+typedef struct {
+	bool live;
+	drop_policy policy;
+	bool luma;
+	int refresh_rate;
+	std::string output_dir;
+	metadata_format metadata;
+	std::string metadata_file;
+	bench_format bench;
+	int scale;
+	std::string scale_file;
+	std::string trace_file;
+	std::string telemetry;
+	int telemetry_interval;
+	int raw_width;
+	int raw_height;
+	long loop;
+	int dispatchers;
+	int max_inflight;
+	double latency_target;
+	int cpu_workers;
+	double spill_latency;
+	std::vector<frame_size> detect_sizes;	// per input, the last one for the rest
+	std::vector<std::string> inputs;
+} app_options;
+
+void print_usage(char* filename);
+
+void parse_command_line_args(int argc, char** argv, app_options& options);
+
+// The resolution input `input` is detected at.
+frame_size detect_size(const app_options& options, int input);
+
+// Nothing is drawn, shown or encoded.
+bool is_headless(const app_options& options);
+
+#endif
@@ -0,0 +1,245 @@
+/*===============================================================*/
+/*                                                               */
+/*                       perf_counters.cpp                       */
+/*                                                               */
+/*        Hardware counters around the detector's hot regions    */
+/*                                                               */
+/*===============================================================*/
+
+#include "perf_counters.h"
+
+#ifdef WITH_PERF_COUNTERS
+
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <iomanip>
+#include <mutex>
+#include <vector>
+
+enum perf_counter {
+	EVENT_CYCLES,
+	EVENT_INSTRUCTIONS,
+	EVENT_L1D_MISSES,
+	EVENT_LLC_MISSES,
+	EVENT_BRANCH_MISSES,
+	NUM_EVENTS
+};
+
+static const char *event_names[NUM_EVENTS] = {
+	"cycles", "instructions", "l1d_misses", "llc_misses", "branch_misses"
+};
+
+static const char *region_names[NUM_PERF_REGIONS] = {
+	"pyramid", "integral", "cascade", "group"
+};
+
+typedef struct {
+	unsigned long long calls[NUM_PERF_REGIONS];
+	unsigned long long counts[NUM_PERF_REGIONS][NUM_EVENTS];
+	bool available[NUM_EVENTS];
+	int error;	// errno of the first event that failed to open
+} thread_totals;
+
+// Totals of every thread that ever entered a region. They outlive their
+// threads so the report can be printed after the streams are joined.
+static std::mutex registry_lock;
+static std::vector<thread_totals*> registry;
+
+class ThreadCounters {
+public:
+	ThreadCounters(void);
+
+	~ThreadCounters(void);
+
+	void begin(perf_region region);
+
+	void end(perf_region region);
+
+private:
+	bool read_counts(unsigned long long counts[NUM_EVENTS]);
+
+	int fds[NUM_EVENTS];
+	int leader;
+	// Position of each event in the group read, -1 when unavailable.
+	int slot[NUM_EVENTS];
+	int members;
+
+	unsigned long long start[NUM_PERF_REGIONS][NUM_EVENTS];
+	thread_totals *totals;
+};
+
+static int open_event(unsigned type, unsigned long long config, int group) {
+	struct perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+
+	attr.size = sizeof(attr);
+	attr.type = type;
+	attr.config = config;
+	attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+	// User space only, which unprivileged processes are usually allowed.
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+
+	return syscall(__NR_perf_event_open, &attr, 0, -1, group, 0);
+}
+
+ThreadCounters::ThreadCounters(void): leader(-1), members(0) {
+	totals = new thread_totals;
+	memset(totals, 0, sizeof(*totals));
+
+	const unsigned types[NUM_EVENTS] = {
+		PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE
+	};
+	const unsigned long long configs[NUM_EVENTS] = {
+		PERF_COUNT_HW_CPU_CYCLES,
+		PERF_COUNT_HW_INSTRUCTIONS,
+		PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+		PERF_COUNT_HW_CACHE_MISSES,
+		PERF_COUNT_HW_BRANCH_MISSES
+	};
+
+	// The first event that opens leads the group, so all of them are read
+	// with one system call and scheduled together.
+	for (int e = 0; e < NUM_EVENTS; e++) {
+		fds[e] = open_event(types[e], configs[e], leader);
+		slot[e] = -1;
+
+		if (fds[e] < 0) {
+			if (!totals->error) totals->error = errno;
+			continue;
+		}
+
+		if (leader < 0) leader = fds[e];
+		slot[e] = members++;
+		totals->available[e] = true;
+	}
+
+	std::lock_guard<std::mutex> lock(registry_lock);
+	registry.push_back(totals);
+}
+
+ThreadCounters::~ThreadCounters(void) {
+	for (int e = 0; e < NUM_EVENTS; e++) {
+		if (fds[e] >= 0) close(fds[e]);
+	}
+}
+
+// Current counts, scaled up if the kernel had to multiplex the group.
+bool ThreadCounters::read_counts(unsigned long long counts[NUM_EVENTS]) {
+	unsigned long long buffer[3 + NUM_EVENTS];
+
+	if (read(leader, buffer, sizeof(buffer)) < (ssize_t) ((3 + members) * sizeof(buffer[0]))) return false;
+
+	unsigned long long enabled = buffer[1], running = buffer[2];
+	double scale = (running && running < enabled) ? enabled / (double) running : 1.0;
+
+	for (int e = 0; e < NUM_EVENTS; e++) {
+		counts[e] = (slot[e] < 0) ? 0 : buffer[3 + slot[e]] * scale;
+	}
+	return true;
+}
+
+void ThreadCounters::begin(perf_region region) {
+	if (leader < 0) return;
+
+	if (!read_counts(start[region])) memset(start[region], 0, sizeof(start[region]));
+}
+
+void ThreadCounters::end(perf_region region) {
+	if (leader < 0) return;
+
+	unsigned long long now[NUM_EVENTS];
+	if (!read_counts(now)) return;
+
+	// Totals are only read once the threads are done.
+	totals->calls[region]++;
+	for (int e = 0; e < NUM_EVENTS; e++) {
+		if (now[e] > start[region][e]) totals->counts[region][e] += now[e] - start[region][e];
+	}
+}
+
+static thread_local ThreadCounters counters;
+
+void perf_begin(perf_region region) {
+	counters.begin(region);
+}
+
+void perf_end(perf_region region) {
+	counters.end(region);
+}
+
+void print_perf_counters(std::ostream& out, bench_format format) {
+	std::lock_guard<std::mutex> lock(registry_lock);
+
+	bool any = false;
+	int error = 0;
+	for (unsigned t = 0; t < registry.size(); t++) {
+		for (int e = 0; e < NUM_EVENTS; e++) any = any || registry[t]->available[e];
+		if (!error) error = registry[t]->error;
+	}
+
+	if (format == BENCH_JSON) {
+		out << "{\"error\":";
+		if (error) out << "\"" << strerror(error) << "\"";
+		else out << "null";
+
+		out << ",\"regions\":[";
+		bool first = true;
+		for (unsigned t = 0; t < registry.size(); t++) {
+			for (int r = 0; r < NUM_PERF_REGIONS; r++) {
+				if (!registry[t]->calls[r]) continue;
+
+				out << (first ? "" : ",") << "{\"thread\":" << t << ",\"region\":\"" << region_names[r]
+					<< "\",\"calls\":" << registry[t]->calls[r];
+				for (int e = 0; e < NUM_EVENTS; e++) {
+					out << ",\"" << event_names[e] << "\":";
+					if (registry[t]->available[e]) out << registry[t]->counts[r][e];
+					else out << "null";
+				}
+				out << "}";
+				first = false;
+			}
+		}
+		out << "]}";
+		return;
+	}
+
+	out << "perf counters per thread and region";
+	if (!any) {
+		out << ": unavailable (" << (error ? strerror(error) : "no instrumented threads") << ")" << std::endl;
+		return;
+	}
+	if (error) out << " (some events unavailable: " << strerror(error) << ")";
+	out << std::endl;
+
+	out << std::left << std::setw(8) << "thread" << std::setw(10) << "region" << std::right << std::setw(10) << "calls";
+	for (int e = 0; e < NUM_EVENTS; e++) out << std::setw(16) << event_names[e];
+	out << std::setw(8) << "ipc" << std::endl;
+
+	for (unsigned t = 0; t < registry.size(); t++) {
+		const thread_totals &totals = *registry[t];
+
+		for (int r = 0; r < NUM_PERF_REGIONS; r++) {
+			if (!totals.calls[r]) continue;
+
+			out << std::left << std::setw(8) << t << std::setw(10) << region_names[r] << std::right << std::setw(10) << totals.calls[r];
+			for (int e = 0; e < NUM_EVENTS; e++) {
+				if (totals.available[e]) out << std::setw(16) << totals.counts[r][e];
+				else out << std::setw(16) << "-";
+			}
+
+			if (totals.available[EVENT_CYCLES] && totals.available[EVENT_INSTRUCTIONS] && totals.counts[r][EVENT_CYCLES]) {
+				out << std::setw(8) << std::fixed << std::setprecision(2)
+					<< totals.counts[r][EVENT_INSTRUCTIONS] / (double) totals.counts[r][EVENT_CYCLES];
+			}
+			else out << std::setw(8) << "-";
+			out << std::endl;
+		}
+	}
+}
+
+#endif
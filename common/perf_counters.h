@@ -0,0 +1,51 @@
+#ifndef PERF_COUNTERS
+#define PERF_COUNTERS
+
+/*===============================================================*/
+/*                                                               */
+/*                        perf_counters.h                        */
+/*                                                               */
+/*        Hardware counters around the detector's hot regions    */
+/*                                                               */
+/*===============================================================*/
+
+#include <ostream>
+
+#include "options.h"
+
+// Instrumented regions of the CPU detector.
+enum perf_region {
+	PERF_PYRAMID,	// nearestNeighbor downsampling
+	PERF_INTEGRAL,	// integral and squared integral images
+	PERF_CASCADE,	// classifier set-up and scan of one level
+	PERF_GROUP,	// grouping of overlapping candidates
+	NUM_PERF_REGIONS
+};
+
+// Built with `make PERF=yes` (WITH_PERF_COUNTERS), every thread that enters
+// a region opens its own perf_event_open group for cycles, instructions,
+// L1D read misses, last-level cache misses and branch misses, and adds the
+// counts between PERF_BEGIN and PERF_END to its totals. Events the kernel or
+// container refuses are reported as unavailable; if none can be opened the
+// macros only cost a branch. Otherwise they compile to nothing.
+#ifdef WITH_PERF_COUNTERS
+
+void perf_begin(perf_region region);
+
+void perf_end(perf_region region);
+
+// Totals per thread and region, as a table or as a JSON object holding
+// the first open error (or null) and one record per thread and region.
+void print_perf_counters(std::ostream& out, bench_format format);
+
+#define PERF_BEGIN(region) perf_begin(region)
+#define PERF_END(region) perf_end(region)
+
+#else
+
+#define PERF_BEGIN(region)
+#define PERF_END(region)
+
+#endif
+
+#endif
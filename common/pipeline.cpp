@@ -0,0 +1,743 @@
+/*===============================================================*/
+/*                                                               */
+/*                          pipeline.cpp                         */
+/*                                                               */
+/*        Decode, detect and output, for either backend          */
+/*                                                               */
+/*===============================================================*/
+
+// standard C/C++ headers
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <iomanip>
+#include <iostream>
+#include <list>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+
+// required OpenCV headers
+#include <opencv2/highgui.hpp>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/videoio.hpp>
+
+// other headers
+#include "bench.h"
+#include "detection_writer.h"
+#include "frame_pool.h"
+#include "frame_source.h"
+#include "haar.h"
+#include "job_pool.h"
+#include "mapped_source.h"
+#include "mosaic.h"
+#include "perf_counters.h"
+#include "pipeline.h"
+#include "preprocess.h"
+#include "queue_stats.h"
+#include "safe_queue.h"
+#include "scaling.h"
+#include "stream_stats.h"
+#include "trace.h"
+#include "video_encoder.h"
+
+typedef struct {
+	long index;
+	cv::Mat frame;		// from the stream's frame pool, empty when headless
+	detect_job *job;	// from the stream's job pool, back to it after grouping
+	timestamp captured;
+	std::chrono::steady_clock::duration decoding;
+	cv::Size source;	// the decoded picture, which metadata refers to
+} frame_request;
+
+// A post-processed frame, held until every earlier frame of the stream is out.
+typedef struct {
+	cv::Mat frame;
+	timestamp captured;
+	int candidates;
+	std::vector<cv::Rect> faces;	// with --metadata only, in source pixels
+} frame_result;
+
+typedef struct {
+	int stream;
+	cv::Mat frame;
+	FramePool *pool;
+	int last;
+	float fps;
+} gui_frame;
+
+// Everything of one stream. Its submitter fills the request queue; the
+// dispatcher it belongs to completes, groups and writes out its frames.
+typedef struct {
+	int stream;
+	cv::Size size;		// what the stream is detected and drawn at
+	SafeQueue<frame_request> *queue;
+	StreamDetector *detector;
+	JobPool *jobs;
+	FramePool frames;	// annotated output frames
+	VideoEncoder *encoder;	// set when saving
+	SafeQueue<gui_frame> *gui_queue;	// set when viewing
+	BenchStats *bench;
+	StreamStats *stats;
+
+	// Jobs still on the backend, oldest first, and finished frames that
+	// wait for an earlier one. Jobs are post-processed as soon as they
+	// finish, whatever their order, so one slow job does not hold up the
+	// others; frames only go out in order. Together both hold at most one
+	// pool of jobs.
+	std::list<frame_request> pending;
+	std::map<long, frame_result> reorder;
+	long next;
+	bool finished;
+	bool starved;		// the last look at the request queue found it empty
+	FrameRate rate;
+
+	// Set once the stream cannot go on, by the dispatcher when the backend
+	// gives up on a frame or by the submitter for frames it cannot read: the
+	// submitter stops and nothing more of the stream is written out.
+	std::atomic<bool> failed;
+} stream_output;
+
+// How long a dispatcher with nothing to do blocks on one job before it
+// checks all its streams again.
+const std::chrono::microseconds COMPLETION_POLL(200);
+
+static void submitter(stream_output &s, cv::VideoCapture &video, const app_options &options) {
+	std::cout << "Submitter thread\n";
+	trace_thread("submitter " + std::to_string(s.stream));
+
+	bool headless = is_headless(options);
+
+	FrameSource source(video, options.live, options.policy, s.stream);
+	Preprocessor preprocess(s.size);
+	preprocess.set_source(video);
+
+	// Frames of a mapped input stay valid until the capture is deleted,
+	// after the stream's jobs are done, so a backend that reads its input in
+	// place may be handed their luma plane instead of a copy.
+	bool lend = s.detector->borrows_input() && dynamic_cast<MappedVideoCapture*>(&video);
+
+	// Reused for every decoded frame; only the downscaled output frame
+	// travels on, and it comes back through the pool.
+	cv::Mat decoded;
+	timestamp captured;
+	unsigned long warm_allocations = 0;
+
+	for (long i = 0; !s.failed && source.read(decoded, captured); i++) {
+		// Raw frames the capture does not describe would be scaled as if
+		// they were a picture.
+		if (!preprocess.accepts(decoded)) {
+			std::cerr << "Stream " << s.stream << ": cannot tell the pixel layout of " << decoded.cols << "x" << decoded.rows
+				<< " frames with " << decoded.channels() << " channel(s) from the capture"
+				<< (options.luma ? "; run without --luma" : "") << ", stopping the stream" << std::endl;
+			s.failed = true;
+			break;
+		}
+
+		// Blocks while every job of this stream is in flight.
+		detect_job *job;
+		{
+			TraceScope trace("buffer wait", s.stream, i);
+			job = s.jobs->acquire();
+		}
+
+		// The dispatcher may have stopped the stream meanwhile.
+		if (s.failed) {
+			s.jobs->release(job);
+			break;
+		}
+		job->frame = i;
+
+		// Headless runs never need the color frame.
+		cv::Mat frame;
+		if (!headless) frame = s.frames.acquire(s.size, CV_8UC3);
+
+		timestamp preprocess_start = std::chrono::steady_clock::now();
+		unsigned long long written = preprocess.bytes_written();
+
+		// The gray image is written straight into the backend's input buffer,
+		// unless the job can take the frame's own plane.
+		if (lend && preprocess.lends(decoded)) preprocess.run_borrowing(decoded, job->input, headless ? NULL : &frame);
+		else {
+			if (lend && !job->input.u) {
+				// It borrowed a frame before; get the job its own buffer back.
+				s.detector->detach(job);
+				s.detector->attach(job);
+			}
+			preprocess.run_into(decoded, job->input, headless ? NULL : &frame);
+		}
+
+		timestamp preprocess_end = std::chrono::steady_clock::now();
+		if (s.bench) {
+			s.bench->record(STAGE_DECODE, source.decode_time());
+			s.bench->record(STAGE_PREPROCESS, preprocess_end - preprocess_start);
+			s.bench->add_bytes(preprocess.bytes_written() - written);
+		}
+
+		trace_span("preprocess", s.stream, i, preprocess_start, preprocess_end);
+
+		job->completed = timestamp();
+		s.detector->submit(job);
+
+		frame_request queue_element;
+		queue_element.index = i;
+		queue_element.frame = std::move(frame);
+		queue_element.job = job;
+		queue_element.captured = captured;
+		queue_element.decoding = source.decode_time();
+		queue_element.source = preprocess.source_size();
+
+		{
+			TraceScope trace("enqueue", s.stream, i);
+			s.queue->enqueue(std::move(queue_element));
+		}
+
+		s.stats->dropped = source.dropped();
+
+		// Everything allocated while decoding the first frame is expected.
+		unsigned long allocations = source.allocations() + preprocess.allocations() + s.frames.allocations();
+		if (!i) warm_allocations = allocations;
+		s.stats->allocations = allocations - warm_allocations;
+	}
+
+	source.close();
+
+	// A request without a job tells the dispatcher this stream is done.
+	frame_request queue_element;
+	queue_element.job = NULL;
+	s.queue->enqueue(std::move(queue_element));
+
+	// Jobs may still read lent frames; the capture goes with its deletion.
+	if (!lend) video.release();
+}
+
+// Group the candidates of a job the backend has completed and draw them (or
+// collect them for the metadata), then give the job back to the pool.
+static void complete(stream_output &s, frame_request &request, bool headless, bool collect, frame_result &result) {
+	long i = request.index;
+	detect_job *job = request.job;
+
+	timestamp group_start = std::chrono::steady_clock::now();
+
+	// Detector hits before grouping, and faces after.
+	std::vector<MyRect> &faces = job->candidates;
+	int candidates = faces.size();
+
+	if (candidates) {
+		const float GROUP_EPS = 0.4f;
+		int minNeighbours = 1;
+
+		PERF_BEGIN(PERF_GROUP);
+		groupRectangles(faces, minNeighbours, GROUP_EPS);
+		PERF_END(PERF_GROUP);
+	}
+
+	timestamp output_start = std::chrono::steady_clock::now();
+
+	result.frame = std::move(request.frame);
+	result.captured = request.captured;
+	result.candidates = candidates;
+
+	if (collect) {
+		// Found at the detection size, reported in the source's pixels.
+		double sx = request.source.width / (double) s.size.width;
+		double sy = request.source.height / (double) s.size.height;
+
+		for (unsigned j = 0; j < faces.size(); j++) {
+			result.faces.push_back(cv::Rect(cvRound(faces[j].x * sx), cvRound(faces[j].y * sy),
+				cvRound(faces[j].width * sx), cvRound(faces[j].height * sy)));
+		}
+	}
+	else if (!headless) {
+		// The frame is the detection size too, so annotated output is drawn
+		// and written at that size, not at the source's.
+		cv::Mat &frame = result.frame;
+
+		for (unsigned j = 0; j < faces.size(); j++) {
+			drawRectangle(frame.data, frame.cols, frame.rows, frame.step, frame.channels(), faces[j]);
+		}
+	}
+
+	timestamp done = std::chrono::steady_clock::now();
+
+	if (tracing()) {
+		trace_span("group", s.stream, i, group_start, output_start);
+		if (!collect && !headless) trace_span("draw", s.stream, i, output_start, done);
+	}
+
+	s.stats->record(request.captured);
+
+	if (s.bench) {
+		if (job->on_cpu) {
+			s.bench->record(STAGE_PYRAMID, job->pyramid_ns);
+			s.bench->record(STAGE_CASCADE, job->cascade_ns);
+		}
+		else s.bench->record(STAGE_ACCELERATOR, group_start - job->submitted);
+
+		s.bench->record(STAGE_GROUP, output_start - group_start);
+		s.bench->record(STAGE_TOTAL, request.decoding + (done - request.captured));
+		s.bench->frame_done(done);
+	}
+
+	s.jobs->release(job);
+}
+
+// Note when the stream's jobs were first seen done, before any is
+// post-processed, so a backend's latency does not include the dispatcher's
+// work on other frames.
+static void stamp(stream_output &s, timestamp now) {
+	for (std::list<frame_request>::iterator it = s.pending.begin(); it != s.pending.end(); it++) {
+		detect_job *job = it->job;
+		if (job->completed == timestamp() && job->response.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+			job->completed = now;
+		}
+	}
+}
+
+// Take the stream's new requests, complete those that are done and write out
+// whatever is in order. Returns false if there was nothing to do.
+static bool dispatch(stream_output &s, DetectionWriter *metadata, const app_options &options) {
+	bool headless = is_headless(options);
+	bool progress = false;
+
+	// Take new requests while there is room.
+	s.starved = false;
+	while (!s.finished && s.pending.size() + s.reorder.size() < (unsigned) s.jobs->size()) {
+		frame_request queue_element;
+		if (!s.queue->try_dequeue(queue_element)) {
+			s.starved = true;
+			break;
+		}
+
+		if (!queue_element.job) s.finished = true;
+		else s.pending.push_back(std::move(queue_element));
+		progress = true;
+	}
+
+	for (std::list<frame_request>::iterator it = s.pending.begin(); it != s.pending.end(); ) {
+		if (it->job->response.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+			it++;
+			continue;
+		}
+		if (it->job->completed == timestamp()) it->job->completed = std::chrono::steady_clock::now();
+
+		if (!s.failed) {
+			TraceScope trace("response.get()", s.stream, it->index);
+
+			try {
+				// A job the backend runs again is polled like any other.
+				if (!s.detector->complete(it->job)) {
+					it++;
+					continue;
+				}
+			}
+			catch (std::exception &e) {
+				std::cerr << "Stream " << s.stream << ": detection failed (" << e.what() << "), stopping the stream" << std::endl;
+				s.failed = true;
+
+				// Frames already done wait for this one in vain.
+				for (std::map<long, frame_result>::iterator r = s.reorder.begin(); r != s.reorder.end(); r++) {
+					s.frames.release(r->second.frame);
+				}
+				s.reorder.clear();
+			}
+		}
+
+		// After a failure the stream's jobs are only waited for and given
+		// back, as the backend may still write their buffers until then.
+		if (s.failed) {
+			s.frames.release(it->frame);
+			s.jobs->release(it->job);
+		}
+		else complete(s, *it, headless, metadata != NULL, s.reorder[it->index]);
+
+		it = s.pending.erase(it);
+		progress = true;
+	}
+
+	// Write out every frame whose predecessors are out.
+	while (!s.reorder.empty() && s.reorder.begin()->first == s.next) {
+		frame_result &result = s.reorder.begin()->second;
+
+		if (metadata) {
+			timestamp output_start = std::chrono::steady_clock::now();
+			metadata->write(s.stream, s.next, result.captured, result.candidates, result.faces);
+
+			timestamp done = std::chrono::steady_clock::now();
+			trace_span("metadata", s.stream, s.next, output_start, done);
+			if (s.bench) s.bench->record(STAGE_OUTPUT, done - output_start);
+		}
+
+		if (!headless) {
+			float fps = s.rate.tick();
+
+			std::stringstream fps_stream;
+			fps_stream << std::fixed << std::setprecision(2) << fps;
+
+			// Bottom right, but within frames narrower or lower than the text.
+			cv::Point corner(std::max(0, s.size.width - 165), std::max(15, s.size.height - 15));
+			cv::putText(result.frame, "AVG FPS: " + fps_stream.str(), corner, cv::FONT_HERSHEY_COMPLEX_SMALL, 0.8, cv::Scalar(0,255,0), 1, cv::LINE_AA);
+
+			if (options.live) {
+				std::stringstream latency_stream;
+				latency_stream << std::fixed << std::setprecision(1) << s.stats->last_latency_ms() << " ms, DROPPED: " << s.stats->dropped;
+
+				cv::putText(result.frame, "LATENCY: " + latency_stream.str(), cv::Point(5, 15), cv::FONT_HERSHEY_COMPLEX_SMALL, 0.8, cv::Scalar(0,255,0), 1, cv::LINE_AA);
+			}
+
+			// Either way the frame goes back to the pool once used.
+			if (s.encoder) s.encoder->write(result.frame, &s.frames);
+			else {
+				gui_frame gui;
+				gui.stream = s.stream;
+				gui.last = 0;
+				gui.fps = fps;
+				gui.frame = std::move(result.frame);
+				gui.pool = &s.frames;
+
+				s.gui_queue->enqueue(gui);
+			}
+		}
+
+		s.reorder.erase(s.reorder.begin());
+		s.next++;
+	}
+
+	return progress;
+}
+
+// Completes the jobs of several streams on one thread, so the thread count
+// does not grow with the number of streams. Each stream belongs to exactly
+// one dispatcher, which keeps its frames in order.
+static void dispatcher(int id, std::vector<stream_output*> streams, DetectionWriter *metadata, const app_options &options) {
+	std::cout << "Dispatcher thread\n";
+	trace_thread("dispatcher " + std::to_string(id));
+
+	for (unsigned i = 0; i < streams.size(); i++) {
+		if (streams[i]->bench) streams[i]->bench->start();
+	}
+
+	for (unsigned turn = 0; !streams.empty(); turn++) {
+		bool progress = false;
+
+		timestamp now = std::chrono::steady_clock::now();
+		for (unsigned i = 0; i < streams.size(); i++) stamp(*streams[i], now);
+
+		for (unsigned i = 0; i < streams.size(); ) {
+			stream_output *s = streams[i];
+			if (dispatch(*s, metadata, options)) progress = true;
+
+			if (!s->finished || !s->pending.empty()) {
+				i++;
+				continue;
+			}
+
+			// Flushes and closes the stream's file.
+			delete s->encoder;
+			s->encoder = NULL;
+
+			if (s->gui_queue) {
+				// Let the viewer know this stream is done.
+				gui_frame gui;
+				gui.stream = s->stream;
+				gui.pool = &s->frames;
+				gui.last = 1;
+				gui.fps = 0;
+				s->gui_queue->enqueue(gui);
+			}
+
+			streams.erase(streams.begin() + i);
+		}
+
+		// Records of a quiet stream still reach the reader on time.
+		if (metadata) metadata->poll();
+
+		if (progress || streams.empty()) continue;
+
+		// Nothing to do: wait a little on the oldest job of a busy stream,
+		// taking turns, or for the submitters if none is busy.
+		stream_output *busy = NULL;
+		for (unsigned i = 0; i < streams.size() && !busy; i++) {
+			stream_output *s = streams[(turn + i) % streams.size()];
+			if (!s->pending.empty()) busy = s;
+		}
+
+		timestamp idle = std::chrono::steady_clock::now();
+		if (busy) {
+			TraceScope trace("completion wait", busy->stream, busy->pending.front().index);
+			busy->pending.front().job->response.wait_for(COMPLETION_POLL);
+		}
+		else std::this_thread::sleep_for(COMPLETION_POLL);
+
+		// Streams whose queue was empty waited on it as well, though polling.
+		std::chrono::steady_clock::duration waited = std::chrono::steady_clock::now() - idle;
+		for (unsigned i = 0; i < streams.size(); i++) {
+			if (streams[i]->starved) streams[i]->queue->waited(waited);
+		}
+	}
+}
+
+static void viewer(unsigned long num_videos, cv::Size tile, SafeQueue<gui_frame> &queue, const std::string &title, const app_options &options) {
+	std::cout << "Viewer Thread\n";
+	trace_thread("viewer");
+
+	cv::namedWindow("output", 1);
+	cv::setWindowTitle("output", title);
+
+	Mosaic mosaic(num_videos, tile);
+	std::vector<float> fps(num_videos, 0.0f);
+
+	// Frames are copied into their tile as they arrive; the screen itself
+	// is redrawn at a fixed rate, however many frames came in meanwhile.
+	std::chrono::steady_clock::duration period = std::chrono::microseconds(1000000 / options.refresh_rate);
+	std::chrono::steady_clock::time_point next_refresh = std::chrono::steady_clock::now() + period;
+
+	unsigned videos_finished = 0;
+	while (videos_finished < num_videos) {
+		// A backlog would keep the queue from ever running dry, so the
+		// screen's turn comes on time regardless.
+		gui_frame gui;
+		while (videos_finished < num_videos && std::chrono::steady_clock::now() < next_refresh && queue.dequeue(gui, next_refresh)) {
+			if (gui.last) {
+				// Finished streams no longer count towards the total.
+				fps[gui.stream] = 0.0f;
+				videos_finished++;
+				continue;
+			}
+
+			{
+				TraceScope trace("tile", gui.stream, -1);
+				mosaic.update(gui.stream, gui.frame);
+			}
+			fps[gui.stream] = gui.fps;
+
+			// The canvas has its own copy now.
+			gui.pool->release(gui.frame);
+		}
+
+		float fps_sum = 0.0f;
+		for (unsigned i = 0; i < fps.size(); i++) fps_sum += fps[i];
+
+		std::stringstream fps_stream;
+		fps_stream << std::fixed << std::setprecision(2) << fps_sum;
+
+		mosaic.set_status("AVG System FPS: " + fps_stream.str());
+
+		{
+			TraceScope trace("display", -1, -1);
+			cv::imshow("output", mosaic.canvas());
+			cv::waitKey(1);
+		}
+
+		next_refresh += period;
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		if (next_refresh < now) next_refresh = now + period;
+	}
+
+	return;
+}
+
+// A stream's detector for frames of `size`, its pool of `depth` jobs and
+// its request queue, without an output yet.
+static stream_output *open_stream(int stream, DetectorBackend &backend, int depth, cv::Size size, BenchStats *bench, StreamStats &stats) {
+	stream_output *s = new stream_output;
+	s->stream = stream;
+	s->size = size;
+	s->detector = backend.open(stream, depth, size);
+	s->jobs = new JobPool(s->detector, stream, depth);
+	s->jobs->monitor("free buffers " + std::to_string(stream));
+	s->queue = new SafeQueue<frame_request>(depth);
+	s->queue->monitor("requests " + std::to_string(stream));
+	s->encoder = NULL;
+	s->gui_queue = NULL;
+	s->bench = bench;
+	s->stats = &stats;
+	s->next = 0;
+	s->finished = false;
+	s->starved = false;
+	s->failed = false;
+	return s;
+}
+
+static void close_stream(stream_output *s) {
+	delete s->encoder;
+	delete s->queue;
+	delete s->jobs;
+	delete s->detector;
+	delete s;
+}
+
+int run_pipeline(const app_options& options, const backend_factory& open_backend, pipeline_output output) {
+	// Scaling runs replay the inputs headless; nothing is encoded or shown.
+	if (options.scale) {
+		return run_scaling(options, open_backend, [&](DetectorBackend &backend, int depth, int stream, cv::VideoCapture &video,
+			BenchStats &bench, StreamStats &stats) {
+			// Stream i replays input i modulo the number of inputs.
+			frame_size size = detect_size(options, stream % options.inputs.size());
+			stream_output *s = open_stream(stream, backend, depth, cv::Size(size.width, size.height), &bench, stats);
+
+			std::thread dispatcherThread(dispatcher, stream, std::vector<stream_output*>(1, s), (DetectionWriter *) NULL, std::cref(options));
+			submitter(*s, video, options);
+			dispatcherThread.join();
+
+			s->detector->finish(&bench);
+			close_stream(s);
+		});
+	}
+
+	// Tracing covers normal runs; --scale would repeat every stream many times.
+	if (!options.trace_file.empty()) trace_enable();
+
+	TelemetryExporter *telemetry = NULL;
+	if (!options.telemetry.empty()) {
+		telemetry = new TelemetryExporter(options.telemetry, options.telemetry_interval);
+		if (!telemetry->isOpened()) std::cerr << "Unable to open telemetry target: " << options.telemetry << std::endl;
+	}
+
+	std::vector<std::string> videoName;
+	std::vector<std::string> outputName;
+	std::vector<cv::VideoCapture*> video;
+	std::vector<cv::Size> size;
+
+	for (unsigned i = 0; i < options.inputs.size(); i++) {
+		video.push_back(open_video(options.inputs[i], options));
+
+		if (!video.back()->isOpened()) {
+			std::cerr << "Unable to open video file: " << options.inputs[i] << std::endl;
+			delete video.back();
+			video.pop_back();
+		}
+		else {
+			videoName.push_back(std::to_string(video.size()) + ": " + options.inputs[i]);
+			outputName.push_back(output_filename(options.output_dir, video.size(), options.inputs[i]));
+
+			// Sizes follow the inputs as given, whether or not all opened.
+			frame_size detect = detect_size(options, i);
+			size.push_back(cv::Size(detect.width, detect.height));
+		}
+	}
+
+	DetectionWriter *metadata = NULL;
+	if (options.metadata != METADATA_NONE) {
+		metadata = new DetectionWriter(options.metadata_file, options.metadata);
+		if (!metadata->isOpened()) {
+			std::cerr << "Unable to open metadata file: " << options.metadata_file << std::endl;
+
+			delete metadata;
+			for (unsigned i = 0; i < video.size(); i++) delete video[i];
+			delete telemetry;
+			return -1;
+		}
+	}
+
+	bool headless = is_headless(options);
+
+	SafeQueue<gui_frame> gui_queue;
+	if (output == OUTPUT_WINDOW) gui_queue.monitor("gui");
+
+	std::vector<std::thread> submitters(video.size());
+	std::vector<stream_output*> outputs;
+	std::vector<StreamStats> stats(video.size());
+	std::vector<BenchStats> bench(video.size());
+
+	DetectorBackend *backend;
+	try {
+		backend = open_backend(video.size());
+	}
+	catch (std::exception &e) {
+		std::cerr << "Unable to start the detector: " << e.what() << std::endl;
+
+		delete metadata;
+		for (unsigned i = 0; i < video.size(); i++) delete video[i];
+		delete telemetry;
+		return -1;
+	}
+
+	// The job pool and the request queue never hold more frames than the
+	// backend allows in flight.
+	int depth = backend->depth(options, video.size());
+
+	for (unsigned i = 0; i < video.size(); i++) {
+		// Submitter and dispatcher record different stages of the same stream.
+		stream_output *s = open_stream(i, *backend, depth, size[i], options.bench ? &bench[i] : NULL, stats[i]);
+
+		if (!headless && output == OUTPUT_FILES) {
+			double real_fps = video[i]->get(cv::CAP_PROP_FPS);
+			// Live sources often don't report a frame rate.
+			if (real_fps <= 0) real_fps = 30;
+
+			// This stream's own encoder thread, so streams encode in parallel.
+			s->frames.reserve(VideoEncoder::QUEUE_SIZE + 2, size[i], CV_8UC3);
+			s->encoder = new VideoEncoder(outputName[i], real_fps, size[i]);
+			if (!s->encoder->isOpened()) std::cerr << "Unable to open output file: " << outputName[i] << std::endl;
+		}
+		else if (!headless) s->gui_queue = &gui_queue;
+
+		outputs.push_back(s);
+	}
+
+	// A few dispatchers complete the jobs of all streams; stream i belongs
+	// to dispatcher i % n.
+	unsigned n_dispatchers = options.dispatchers ? options.dispatchers : (outputs.size() + 7) / 8;
+	n_dispatchers = std::min(n_dispatchers, (unsigned) outputs.size());
+
+	std::vector<std::vector<stream_output*> > assigned(n_dispatchers);
+	for (unsigned i = 0; i < outputs.size(); i++) assigned[i % n_dispatchers].push_back(outputs[i]);
+
+	std::vector<std::thread> dispatchers;
+	for (unsigned d = 0; d < n_dispatchers; d++) {
+		dispatchers.push_back(std::thread(dispatcher, d, assigned[d], metadata, std::cref(options)));
+	}
+
+	for (unsigned i = 0; i < video.size(); i++) {
+		submitters[i] = std::thread(submitter, std::ref(*outputs[i]), std::ref(*video[i]), std::cref(options));
+	}
+
+	if (video.size() && !headless && output == OUTPUT_WINDOW) {
+		// Tiles fit the largest stream; smaller ones are scaled up to them.
+		cv::Size tile;
+		for (unsigned i = 0; i < size.size(); i++) {
+			tile.width = std::max(tile.width, size[i].width);
+			tile.height = std::max(tile.height, size[i].height);
+		}
+
+		std::thread viewerThread(viewer, video.size(), tile, std::ref(gui_queue),
+			"InAccel Face Detection (" + std::string(backend->name()) + ")", std::cref(options));
+
+		viewerThread.join();
+	}
+
+	for (unsigned i = 0; i < submitters.size(); i++) submitters[i].join();
+
+	for (unsigned d = 0; d < dispatchers.size(); d++) dispatchers[d].join();
+
+	// Only now, as jobs may have read frames straight from a mapping.
+	for (unsigned i = 0; i < video.size(); i++) delete video[i];
+
+	for (unsigned i = 0; i < outputs.size(); i++) {
+		stats[i].print(videoName[i]);
+		outputs[i]->detector->print(videoName[i]);
+		outputs[i]->detector->finish(options.bench ? &bench[i] : NULL);
+	}
+
+	// The last telemetry dump still sees every queue.
+	delete telemetry;
+
+	// A stream the backend gave up on fails the whole run.
+	int status = 0;
+	for (unsigned i = 0; i < outputs.size(); i++) {
+		if (outputs[i]->failed) status = -1;
+		close_stream(outputs[i]);
+	}
+	delete backend;
+
+	if (options.bench) print_bench(bench, videoName, options.bench);
+
+	if (tracing()) write_trace(options.trace_file);
+
+	delete metadata;
+
+	return status;
+}
@@ -0,0 +1,29 @@
+#ifndef PIPELINE
+#define PIPELINE
+
+/*===============================================================*/
+/*                                                               */
+/*                           pipeline.h                          */
+/*                                                               */
+/*        Decode, detect and output, for either backend          */
+/*                                                               */
+/*===============================================================*/
+
+#include "detector.h"
+#include "options.h"
+
+// Where annotated frames go when the run is not headless.
+enum pipeline_output {
+	OUTPUT_FILES,	// one video per input, in --output-dir
+	OUTPUT_WINDOW	// a mosaic of all streams on screen
+};
+
+// The whole application on a backend from `open_backend`. Every stream has a
+// submitter thread that decodes, preprocesses into a pooled job and submits
+// it; a few dispatcher threads complete the jobs of all streams as they
+// finish, group and draw the candidates and hand the frames, in order, to the
+// output or the metadata writer. Also runs --scale, with a backend for every
+// stream count. Returns the exit status.
+int run_pipeline(const app_options& options, const backend_factory& open_backend, pipeline_output output);
+
+#endif
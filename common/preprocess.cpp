@@ -0,0 +1,150 @@
+/*===============================================================*/
+/*                                                               */
+/*                        preprocess.cpp                         */
+/*                                                               */
+/*        Decoded frame to detector input, without allocating    */
+/*                                                               */
+/*===============================================================*/
+
+#include <opencv2/imgproc.hpp>
+
+#include "preprocess.h"
+
+Preprocessor::Preprocessor(cv::Size size): size(size), reported(0, 0), fourcc(0), n_allocations(0), n_bytes(0) {
+	gray.create(size, CV_8UC1);
+}
+
+void Preprocessor::set_source(const cv::VideoCapture& video) {
+	reported = cv::Size(video.get(cv::CAP_PROP_FRAME_WIDTH), video.get(cv::CAP_PROP_FRAME_HEIGHT));
+	fourcc = video.get(cv::CAP_PROP_FOURCC);
+}
+
+frame_layout Preprocessor::layout(const cv::Mat& frame) const {
+	if (frame.channels() == 3) return LAYOUT_BGR;
+
+	// A reported size of zero matches nothing.
+	if (frame.channels() == 2 && frame.size() == reported) {
+		return (fourcc == cv::VideoWriter::fourcc('U','Y','V','Y')) ? LAYOUT_UYVY : LAYOUT_YUYV;
+	}
+
+	if (frame.channels() == 1 && frame.size() == reported) return LAYOUT_GRAY;
+
+	if (frame.channels() == 1 && frame.cols == reported.width && reported.height % 2 == 0 &&
+		frame.rows == reported.height * 3 / 2) {
+		if (fourcc == cv::VideoWriter::fourcc('N','V','1','2')) return LAYOUT_NV12;
+		if (fourcc == cv::VideoWriter::fourcc('Y','V','1','2')) return LAYOUT_YV12;
+		return LAYOUT_I420;
+	}
+
+	return LAYOUT_UNKNOWN;
+}
+
+static size_t bytes(const cv::Mat& image) {
+	return image.total() * image.elemSize();
+}
+
+const cv::Mat& Preprocessor::run(const cv::Mat& frame, cv::Mat* color) {
+	convert(frame, gray, color, false);
+	return gray;
+}
+
+void Preprocessor::run_into(const cv::Mat& frame, cv::Mat& gray, cv::Mat* color) {
+	CV_Assert(gray.size() == size && gray.type() == CV_8UC1);
+	convert(frame, gray, color, false);
+}
+
+bool Preprocessor::lends(const cv::Mat& frame) const {
+	switch (layout(frame)) {
+		case LAYOUT_GRAY: return frame.size() == size;
+		case LAYOUT_I420:
+		case LAYOUT_YV12:
+		case LAYOUT_NV12: return reported == size;
+		default: return false;
+	}
+}
+
+void Preprocessor::run_borrowing(const cv::Mat& frame, cv::Mat& gray, cv::Mat* color) {
+	CV_Assert(lends(frame));
+	convert(frame, gray, color, true);
+}
+
+void Preprocessor::convert(const cv::Mat& frame, cv::Mat& gray, cv::Mat* color, bool borrow) {
+	unsigned char *full_gray_data = full_gray.data;
+	unsigned char *full_color_data = full_color.data;
+	unsigned char *gray_data = gray.data;
+	unsigned char *color_data = color ? color->data : NULL;
+
+	frame_layout l = layout(frame);
+	CV_Assert(l != LAYOUT_UNKNOWN);
+	source = frame.size();
+
+	if (l == LAYOUT_BGR) {
+		if (color) {
+			// The small color frame is needed anyway, so convert that
+			// one: a single full resolution pass instead of two.
+			cv::resize(frame, *color, size);
+			cv::cvtColor(*color, gray, cv::COLOR_BGR2GRAY);
+			n_bytes += bytes(*color);
+		}
+		else {
+			// Drop to one channel first so the downscale touches a
+			// third of the bytes.
+			cv::cvtColor(frame, full_gray, cv::COLOR_BGR2GRAY);
+			cv::resize(full_gray, gray, size);
+			n_bytes += bytes(full_gray);
+		}
+	}
+	else {
+		// The luma plane is the gray image; use it where it lies.
+		cv::Mat luma;
+		switch (l) {
+			case LAYOUT_YUYV:
+				cv::extractChannel(frame, full_gray, 0);
+				n_bytes += bytes(full_gray);
+				luma = full_gray;
+				break;
+			case LAYOUT_UYVY:
+				cv::extractChannel(frame, full_gray, 1);
+				n_bytes += bytes(full_gray);
+				luma = full_gray;
+				break;
+			case LAYOUT_GRAY:
+				luma = frame;
+				break;
+			default:
+				luma = frame.rowRange(0, reported.height);
+				break;
+		}
+
+		source = luma.size();
+
+		// A plane of the frame itself that needs no scaling is the detector
+		// input as it is.
+		if (borrow) gray = luma;
+		else cv::resize(luma, gray, size);
+
+		if (color && l == LAYOUT_GRAY) {
+			// Nothing more to recover, just widen the small image.
+			cv::cvtColor(gray, *color, cv::COLOR_GRAY2BGR);
+			n_bytes += bytes(*color);
+		}
+		else if (color) {
+			switch (l) {
+				case LAYOUT_YUYV: cv::cvtColor(frame, full_color, cv::COLOR_YUV2BGR_YUYV); break;
+				case LAYOUT_UYVY: cv::cvtColor(frame, full_color, cv::COLOR_YUV2BGR_UYVY); break;
+				case LAYOUT_YV12: cv::cvtColor(frame, full_color, cv::COLOR_YUV2BGR_YV12); break;
+				case LAYOUT_NV12: cv::cvtColor(frame, full_color, cv::COLOR_YUV2BGR_NV12); break;
+				default: cv::cvtColor(frame, full_color, cv::COLOR_YUV2BGR_I420); break;
+			}
+			cv::resize(full_color, *color, size);
+			n_bytes += bytes(full_color) + bytes(*color);
+		}
+	}
+
+	if (full_gray.data != full_gray_data) n_allocations++;
+	if (full_color.data != full_color_data) n_allocations++;
+	if (gray.data != gray_data && !borrow) n_allocations++;
+	if (color && color->data != color_data) n_allocations++;
+
+	if (!borrow) n_bytes += bytes(gray);
+}
@@ -0,0 +1,96 @@
+#ifndef PREPROCESS
+#define PREPROCESS
+
+/*===============================================================*/
+/*                                                               */
+/*                         preprocess.h                          */
+/*                                                               */
+/*        Decoded frame to detector input, without allocating    */
+/*                                                               */
+/*===============================================================*/
+
+#include <opencv2/core.hpp>
+#include <opencv2/videoio.hpp>
+
+// Pixel layouts a decoder may hand us.
+enum frame_layout {
+	LAYOUT_BGR,	// 3 channels, OpenCV's default
+	LAYOUT_GRAY,	// 1 channel luma plane
+	LAYOUT_I420,	// Y plane followed by U and V planes
+	LAYOUT_YV12,	// Y plane followed by V and U planes
+	LAYOUT_NV12,	// Y plane followed by interleaved UV
+	LAYOUT_YUYV,	// packed 4:2:2, luma in even bytes
+	LAYOUT_UYVY,	// packed 4:2:2, luma in odd bytes
+	LAYOUT_UNKNOWN	// raw, but not of the size the capture reports
+};
+
+// Converts decoded frames into the gray, detection sized image the cascade
+// consumes. All intermediate buffers live as long as the object, so after the
+// first frame nothing is allocated unless the input size changes.
+//
+// Besides BGR, raw YUV frames (CAP_PROP_CONVERT_RGB=false) are accepted: the
+// luma plane is then used in place and the costly conversion to color only
+// happens when a color frame is actually asked for. Raw frames must match the
+// width and height the capture reports, as a picture (gray, 4:2:2) or as a
+// 4:2:0 plane set one and a half times as high; anything else, e.g. the
+// packed 1xN buffers some backends return, is rejected rather than guessed at.
+class Preprocessor {
+public:
+	Preprocessor(cv::Size size);
+
+	// Use the capture's reported size and FOURCC to tell raw YUV layouts
+	// apart. Without it only BGR frames are accepted.
+	void set_source(const cv::VideoCapture& video);
+
+	// Whether the frame's layout is known, which run() and run_into()
+	// require.
+	bool accepts(const cv::Mat& frame) const { return layout(frame) != LAYOUT_UNKNOWN; }
+
+	// Returns the gray detector input. If `color` is given it also receives
+	// the downscaled color frame for annotated output. The returned image
+	// stays valid until the next call.
+	const cv::Mat& run(const cv::Mat& frame, cv::Mat* color);
+
+	// The same, but the gray image is written into `gray`, which must already
+	// be a detection sized CV_8UC1 image. Given a header over an accelerator
+	// buffer, the conversion fills that buffer without another copy.
+	void run_into(const cv::Mat& frame, cv::Mat& gray, cv::Mat* color);
+
+	// Whether the frame's luma plane already is the gray image: a gray or
+	// planar 4:2:0 frame at the detection size.
+	bool lends(const cv::Mat& frame) const;
+
+	// Like run_into() for such a frame, but `gray` becomes a header over its
+	// luma plane instead of receiving a copy, valid only as long as the
+	// frame's pixels. `gray` must be pointed back at a buffer of the caller's
+	// before a frame that does not lend is written into it.
+	void run_borrowing(const cv::Mat& frame, cv::Mat& gray, cv::Mat* color);
+
+	// The size of the last frame's picture (its luma plane for raw YUV)
+	// before it was scaled to the detection size.
+	cv::Size source_size(void) const { return source; }
+
+	unsigned long allocations(void) const { return n_allocations; }
+
+	// Bytes written by the conversions so far, intermediate images included.
+	unsigned long long bytes_written(void) const { return n_bytes; }
+
+private:
+	frame_layout layout(const cv::Mat& frame) const;
+
+	// With `borrow`, `gray` is pointed at the frame's luma plane if it lends.
+	void convert(const cv::Mat& frame, cv::Mat& gray, cv::Mat* color, bool borrow);
+
+	cv::Size size;
+	cv::Size source;
+	cv::Size reported;	// by the capture, zero if unknown
+	int fourcc;
+
+	cv::Mat full_gray;
+	cv::Mat full_color;
+	cv::Mat gray;
+	unsigned long n_allocations;
+	unsigned long long n_bytes;
+};
+
+#endif
@@ -0,0 +1,305 @@
+/*===============================================================*/
+/*                                                               */
+/*                        queue_stats.cpp                        */
+/*                                                               */
+/*          Queue occupancy and stall telemetry (--telemetry)    */
+/*                                                               */
+/*===============================================================*/
+
+#include <errno.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+#include "queue_stats.h"
+
+typedef struct {
+	const void *queue;
+	std::string name;
+	std::function<queue_stats(void)> snapshot;
+	std::function<limit_stats(void)> limit;		// empty without one
+} monitored_queue;
+
+static std::mutex registry_lock;
+static std::vector<monitored_queue> registry;
+
+void monitor_queue(const void *queue, const std::string& name, const std::function<queue_stats(void)>& snapshot) {
+	monitor_queue(queue, name, snapshot, std::function<limit_stats(void)>());
+}
+
+void monitor_queue(const void *queue, const std::string& name, const std::function<queue_stats(void)>& snapshot,
+	const std::function<limit_stats(void)>& limit) {
+	monitored_queue entry;
+	entry.queue = queue;
+	entry.name = name;
+	entry.snapshot = snapshot;
+	entry.limit = limit;
+
+	std::lock_guard<std::mutex> lock(registry_lock);
+	registry.push_back(entry);
+}
+
+void unmonitor_queue(const void *queue) {
+	std::lock_guard<std::mutex> lock(registry_lock);
+
+	for (unsigned i = 0; i < registry.size(); i++) {
+		if (registry[i].queue == queue) {
+			registry.erase(registry.begin() + i);
+			return;
+		}
+	}
+}
+
+// Label values escape backslash, double quote and line feed.
+static std::string label(const std::string& name) {
+	std::string out;
+	for (unsigned i = 0; i < name.size(); i++) {
+		if (name[i] == '\\' || name[i] == '"') out += '\\';
+		if (name[i] == '\n') out += "\\n";
+		else out += name[i];
+	}
+	return out;
+}
+
+std::string queue_metrics(void) {
+	std::vector<std::string> names;
+	std::vector<queue_stats> stats;
+	std::vector<std::string> limit_names;
+	std::vector<limit_stats> limits;
+	{
+		std::lock_guard<std::mutex> lock(registry_lock);
+		for (unsigned i = 0; i < registry.size(); i++) {
+			names.push_back(label(registry[i].name));
+			stats.push_back(registry[i].snapshot());
+			if (registry[i].limit) {
+				limit_names.push_back(names.back());
+				limits.push_back(registry[i].limit());
+			}
+		}
+	}
+
+	std::stringstream out;
+
+	out << "# HELP facedetect_queue_depth Elements currently queued.\n";
+	out << "# TYPE facedetect_queue_depth gauge\n";
+	for (unsigned i = 0; i < stats.size(); i++) {
+		out << "facedetect_queue_depth{queue=\"" << names[i] << "\"} " << stats[i].depth << "\n";
+	}
+
+	out << "# HELP facedetect_queue_high_water Most elements ever queued at once.\n";
+	out << "# TYPE facedetect_queue_high_water gauge\n";
+	for (unsigned i = 0; i < stats.size(); i++) {
+		out << "facedetect_queue_high_water{queue=\"" << names[i] << "\"} " << stats[i].high_water << "\n";
+	}
+
+	out << "# HELP facedetect_queue_capacity Elements a bounded queue holds before enqueue blocks.\n";
+	out << "# TYPE facedetect_queue_capacity gauge\n";
+	for (unsigned i = 0; i < stats.size(); i++) {
+		if (stats[i].capacity >= 0) out << "facedetect_queue_capacity{queue=\"" << names[i] << "\"} " << stats[i].capacity << "\n";
+	}
+
+	out << "# HELP facedetect_queue_enqueued_total Elements added.\n";
+	out << "# TYPE facedetect_queue_enqueued_total counter\n";
+	for (unsigned i = 0; i < stats.size(); i++) {
+		out << "facedetect_queue_enqueued_total{queue=\"" << names[i] << "\"} " << stats[i].enqueued << "\n";
+	}
+
+	out << "# HELP facedetect_queue_dequeued_total Elements taken.\n";
+	out << "# TYPE facedetect_queue_dequeued_total counter\n";
+	for (unsigned i = 0; i < stats.size(); i++) {
+		out << "facedetect_queue_dequeued_total{queue=\"" << names[i] << "\"} " << stats[i].dequeued << "\n";
+	}
+
+	out << "# HELP facedetect_queue_enqueue_blocked_total Enqueues that found the queue full.\n";
+	out << "# TYPE facedetect_queue_enqueue_blocked_total counter\n";
+	for (unsigned i = 0; i < stats.size(); i++) {
+		out << "facedetect_queue_enqueue_blocked_total{queue=\"" << names[i] << "\"} " << stats[i].enqueue_blocked << "\n";
+	}
+
+	out << "# HELP facedetect_queue_enqueue_blocked_seconds_total Time producers spent waiting for room.\n";
+	out << "# TYPE facedetect_queue_enqueue_blocked_seconds_total counter\n";
+	for (unsigned i = 0; i < stats.size(); i++) {
+		out << "facedetect_queue_enqueue_blocked_seconds_total{queue=\"" << names[i] << "\"} "
+			<< std::chrono::duration<double>(stats[i].enqueue_blocked_time).count() << "\n";
+	}
+
+	out << "# HELP facedetect_queue_dequeue_waited_total Dequeues that found the queue empty.\n";
+	out << "# TYPE facedetect_queue_dequeue_waited_total counter\n";
+	for (unsigned i = 0; i < stats.size(); i++) {
+		out << "facedetect_queue_dequeue_waited_total{queue=\"" << names[i] << "\"} " << stats[i].dequeue_waited << "\n";
+	}
+
+	out << "# HELP facedetect_queue_dequeue_wait_seconds_total Time consumers spent waiting for an element.\n";
+	out << "# TYPE facedetect_queue_dequeue_wait_seconds_total counter\n";
+	for (unsigned i = 0; i < stats.size(); i++) {
+		out << "facedetect_queue_dequeue_wait_seconds_total{queue=\"" << names[i] << "\"} "
+			<< std::chrono::duration<double>(stats[i].dequeue_wait_time).count() << "\n";
+	}
+
+	out << "# HELP facedetect_limit_lowest Lowest adaptive capacity so far.\n";
+	out << "# TYPE facedetect_limit_lowest gauge\n";
+	for (unsigned i = 0; i < limits.size(); i++) {
+		out << "facedetect_limit_lowest{queue=\"" << limit_names[i] << "\"} " << limits[i].lowest << "\n";
+	}
+
+	out << "# HELP facedetect_limit_highest Highest adaptive capacity so far.\n";
+	out << "# TYPE facedetect_limit_highest gauge\n";
+	for (unsigned i = 0; i < limits.size(); i++) {
+		out << "facedetect_limit_highest{queue=\"" << limit_names[i] << "\"} " << limits[i].highest << "\n";
+	}
+
+	out << "# HELP facedetect_limit_decisions_total Windows after which the capacity was grown, shrunk, cut for latency or held.\n";
+	out << "# TYPE facedetect_limit_decisions_total counter\n";
+	for (unsigned i = 0; i < limits.size(); i++) {
+		std::string prefix = "facedetect_limit_decisions_total{queue=\"" + limit_names[i] + "\",decision=";
+		out << prefix << "\"grown\"} " << limits[i].grown << "\n";
+		out << prefix << "\"shrunk\"} " << limits[i].shrunk << "\n";
+		out << prefix << "\"cut\"} " << limits[i].cut << "\n";
+		out << prefix << "\"held\"} " << limits[i].held << "\n";
+	}
+
+	out << "# HELP facedetect_limit_window_latency_seconds Mean latency of the last window, 0 before the first.\n";
+	out << "# TYPE facedetect_limit_window_latency_seconds gauge\n";
+	for (unsigned i = 0; i < limits.size(); i++) {
+		out << "facedetect_limit_window_latency_seconds{queue=\"" << limit_names[i] << "\"} "
+			<< std::chrono::duration<double>(limits[i].window_latency).count() << "\n";
+	}
+
+	out << "# HELP facedetect_limit_lowest_latency_seconds Lowest window mean latency, 0 before the first.\n";
+	out << "# TYPE facedetect_limit_lowest_latency_seconds gauge\n";
+	for (unsigned i = 0; i < limits.size(); i++) {
+		out << "facedetect_limit_lowest_latency_seconds{queue=\"" << limit_names[i] << "\"} "
+			<< std::chrono::duration<double>(limits[i].lowest_latency).count() << "\n";
+	}
+
+	return out.str();
+}
+
+TelemetryExporter::TelemetryExporter(const std::string& target, int interval_ms):
+	socket(target.compare(0, 5, "unix:") == 0), interval_ms(interval_ms), listener(-1), opened(false), stopped(false) {
+	path = socket ? target.substr(5) : target;
+
+	if (!socket) {
+		// Check up front that the file can be written at all.
+		opened = std::ofstream(path + ".tmp").is_open();
+		if (opened) worker = std::thread(&TelemetryExporter::write_file, this);
+		return;
+	}
+
+	struct sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if (path.size() >= sizeof(address.sun_path)) {
+		std::cerr << "Telemetry socket path too long: " << path << std::endl;
+		return;
+	}
+	strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+
+	// A socket left behind by an earlier run would make bind fail; anything
+	// else at that path is not ours to remove.
+	struct stat existing;
+	if (lstat(path.c_str(), &existing) == 0) {
+		if (!S_ISSOCK(existing.st_mode)) {
+			std::cerr << "Telemetry socket " << path << ": exists and is not a socket" << std::endl;
+			return;
+		}
+		unlink(path.c_str());
+	}
+
+	listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+	if (listener < 0) {
+		std::cerr << "Telemetry socket " << path << ": socket: " << strerror(errno) << std::endl;
+		return;
+	}
+
+	if (bind(listener, (struct sockaddr *) &address, sizeof(address)) < 0) {
+		std::cerr << "Telemetry socket " << path << ": bind: " << strerror(errno) << std::endl;
+		close(listener);
+		listener = -1;
+		return;
+	}
+	if (listen(listener, 4) < 0) {
+		std::cerr << "Telemetry socket " << path << ": listen: " << strerror(errno) << std::endl;
+		close(listener);
+		listener = -1;
+		unlink(path.c_str());
+		return;
+	}
+
+	opened = true;
+	worker = std::thread(&TelemetryExporter::serve, this);
+}
+
+TelemetryExporter::~TelemetryExporter(void) {
+	{
+		std::lock_guard<std::mutex> lock(m);
+		stopped = true;
+	}
+	c.notify_all();
+
+	if (worker.joinable()) worker.join();
+
+	if (listener >= 0) {
+		close(listener);
+		unlink(path.c_str());
+	}
+}
+
+// Rewrite the file every interval, and once more on the way out with the
+// final counts. Readers never see a partial file.
+void TelemetryExporter::write_file(void) {
+	std::unique_lock<std::mutex> lock(m);
+
+	while (true) {
+		bool last = stopped;
+		lock.unlock();
+
+		std::string temporary = path + ".tmp";
+		{
+			std::ofstream out(temporary);
+			out << queue_metrics();
+		}
+		rename(temporary.c_str(), path.c_str());
+
+		lock.lock();
+		if (last) return;
+		c.wait_for(lock, std::chrono::milliseconds(interval_ms));
+	}
+}
+
+void TelemetryExporter::serve(void) {
+	struct pollfd pending;
+	pending.fd = listener;
+	pending.events = POLLIN;
+
+	while (true) {
+		{
+			std::lock_guard<std::mutex> lock(m);
+			if (stopped) return;
+		}
+
+		// Wake up now and then to notice the exporter being destroyed.
+		pending.revents = 0;
+		if (poll(&pending, 1, interval_ms) <= 0) continue;
+
+		int client = accept(listener, NULL, NULL);
+		if (client < 0) continue;
+
+		std::string text = queue_metrics();
+		for (size_t sent = 0; sent < text.size(); ) {
+			ssize_t n = send(client, text.data() + sent, text.size() - sent, MSG_NOSIGNAL);
+			if (n <= 0) break;
+			sent += n;
+		}
+		close(client);
+	}
+}
@@ -0,0 +1,89 @@
+#ifndef QUEUE_STATS
+#define QUEUE_STATS
+
+/*===============================================================*/
+/*                                                               */
+/*                         queue_stats.h                         */
+/*                                                               */
+/*          Queue occupancy and stall telemetry (--telemetry)    */
+/*                                                               */
+/*===============================================================*/
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// What a SafeQueue has seen since it was created. Waits are only timed
+// when an operation actually has to block, so the fast path stays free.
+typedef struct {
+	unsigned long depth;
+	unsigned long high_water;
+	long capacity;				// -1 when unbounded
+	unsigned long long enqueued;
+	unsigned long long dequeued;
+	unsigned long long enqueue_blocked;	// enqueues that found the queue full
+	unsigned long long dequeue_waited;	// dequeues that found it empty
+	std::chrono::steady_clock::duration enqueue_blocked_time;
+	std::chrono::steady_clock::duration dequeue_wait_time;
+} queue_stats;
+
+// What an adaptive limit used as a queue's capacity (hw/inflight.h) has
+// decided so far.
+typedef struct {
+	int lowest;
+	int highest;
+	unsigned long grown;
+	unsigned long shrunk;
+	unsigned long cut;
+	unsigned long held;
+	std::chrono::steady_clock::duration window_latency;	// mean of the last window, zero before the first
+	std::chrono::steady_clock::duration lowest_latency;	// lowest such mean, zero before the first
+} limit_stats;
+
+// Publish a queue under `name` until it is withdrawn; `snapshot` is called
+// from the exporter thread and must do its own locking.
+void monitor_queue(const void *queue, const std::string& name, const std::function<queue_stats(void)>& snapshot);
+
+// The same for a queue with an adaptive limit, whose decisions `limit`
+// reports alongside.
+void monitor_queue(const void *queue, const std::string& name, const std::function<queue_stats(void)>& snapshot,
+	const std::function<limit_stats(void)>& limit);
+
+void unmonitor_queue(const void *queue);
+
+// Prometheus text exposition of every monitored queue and limit.
+std::string queue_metrics(void);
+
+// Makes queue_metrics() available while the pipeline runs. A plain path is
+// rewritten atomically every `interval_ms` and once more when the exporter
+// is destroyed; "unix:/path" listens on a UNIX-domain socket and answers
+// every connection with the current metrics, for scrapers that pull.
+class TelemetryExporter {
+public:
+	TelemetryExporter(const std::string& target, int interval_ms);
+
+	~TelemetryExporter(void);
+
+	bool isOpened(void) const { return opened; }
+
+private:
+	void write_file(void);
+
+	void serve(void);
+
+	std::string path;
+	bool socket;
+	int interval_ms;
+	int listener;
+	bool opened;
+
+	std::mutex m;
+	std::condition_variable c;
+	bool stopped;
+	std::thread worker;
+};
+
+#endif
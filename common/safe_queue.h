@@ -0,0 +1,162 @@
+#ifndef SAFE_QUEUE
+#define SAFE_QUEUE
+
+#include <algorithm>
+#include <chrono>
+#include <queue>
+#include <mutex>
+#include <condition_variable>
+#include <string>
+
+#include "queue_stats.h"
+
+// A threadsafe-queue.
+template <class T>
+class SafeQueue {
+public:
+	SafeQueue(): q(), m(), c(), not_full(), maxSize(-1), monitored(false) {
+		clear_stats();
+	}
+
+	SafeQueue(int maxSize): q(), m(), c(), not_full(), maxSize(maxSize), monitored(false) {
+		clear_stats();
+	}
+
+	SafeQueue<T>(const SafeQueue<T>&sq) {
+		maxSize = sq.maxSize;
+		q = sq.q;
+		monitored = false;
+		clear_stats();
+	}
+
+	~SafeQueue(void) {
+		if (monitored) unmonitor_queue(this);
+	}
+
+	// Publish this queue's occupancy and stalls under `name` (see
+	// queue_stats.h) until it is destroyed.
+	void monitor(const std::string& name) {
+		monitor_queue(this, name, [this]() { return stats(); });
+		monitored = true;
+	}
+
+	queue_stats stats(void) {
+		std::lock_guard<std::mutex> lock(m);
+		queue_stats s = telemetry;
+		s.depth = q.size();
+		return s;
+	}
+
+	// Add an element to the queue.
+	// If the queue is bounded and full, wait till there is room.
+	void enqueue(T t) {
+		std::unique_lock<std::mutex> lock(m);
+		if (maxSize >= 0 && q.size() >= (unsigned) maxSize) {
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			while (q.size() >= (unsigned) maxSize) not_full.wait(lock);
+
+			telemetry.enqueue_blocked++;
+			telemetry.enqueue_blocked_time += std::chrono::steady_clock::now() - start;
+		}
+
+		q.push(std::move(t));
+		telemetry.enqueued++;
+		telemetry.high_water = std::max(telemetry.high_water, (unsigned long) q.size());
+
+		lock.unlock();
+		c.notify_one();
+	}
+
+	// Get the "front"-element.
+	// If the queue is empty, wait till a element is avaiable.
+	T dequeue(void) {
+		std::unique_lock<std::mutex> lock(m);
+		if (q.empty()) {
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			while(q.empty()) {
+				// release lock as long as the wait and reaquire it afterwards.
+				c.wait(lock);
+			}
+
+			telemetry.dequeue_waited++;
+			telemetry.dequeue_wait_time += std::chrono::steady_clock::now() - start;
+		}
+
+		T val = std::move(q.front());
+		q.pop();
+		telemetry.dequeued++;
+
+		lock.unlock();
+		not_full.notify_one();
+		return val;
+	}
+
+	// Take the "front"-element if there is one, without waiting.
+	bool try_dequeue(T& t) {
+		std::unique_lock<std::mutex> lock(m);
+		if (q.empty()) return false;
+
+		t = std::move(q.front());
+		q.pop();
+		telemetry.dequeued++;
+
+		lock.unlock();
+		not_full.notify_one();
+		return true;
+	}
+
+	// A consumer that polls with try_dequeue() found the queue empty and
+	// then spent `idle` before it polled again; counted as a dequeue wait.
+	void waited(std::chrono::steady_clock::duration idle) {
+		std::lock_guard<std::mutex> lock(m);
+		telemetry.dequeue_waited++;
+		telemetry.dequeue_wait_time += idle;
+	}
+
+	// Like dequeue(), but give up once `deadline` has passed.
+	// Returns false if no element arrived in time.
+	bool dequeue(T& t, std::chrono::steady_clock::time_point deadline) {
+		std::unique_lock<std::mutex> lock(m);
+		if (q.empty()) {
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			while(q.empty()) {
+				if (c.wait_until(lock, deadline) == std::cv_status::timeout && q.empty()) break;
+			}
+
+			telemetry.dequeue_waited++;
+			telemetry.dequeue_wait_time += std::chrono::steady_clock::now() - start;
+			if (q.empty()) return false;
+		}
+
+		t = std::move(q.front());
+		q.pop();
+		telemetry.dequeued++;
+
+		lock.unlock();
+		not_full.notify_one();
+		return true;
+	}
+
+private:
+	void clear_stats(void) {
+		telemetry.depth = 0;
+		telemetry.high_water = 0;
+		telemetry.capacity = maxSize;
+		telemetry.enqueued = 0;
+		telemetry.dequeued = 0;
+		telemetry.enqueue_blocked = 0;
+		telemetry.dequeue_waited = 0;
+		telemetry.enqueue_blocked_time = std::chrono::steady_clock::duration::zero();
+		telemetry.dequeue_wait_time = std::chrono::steady_clock::duration::zero();
+	}
+
+	std::queue<T> q;
+	std::mutex m;
+	std::condition_variable c;		// signalled when an element arrives
+	std::condition_variable not_full;	// signalled when one is taken
+	int maxSize;
+	bool monitored;
+	queue_stats telemetry;
+};
+
+#endif
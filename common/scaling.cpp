@@ -0,0 +1,118 @@
+/*===============================================================*/
+/*                                                               */
+/*                          scaling.cpp                          */
+/*                                                               */
+/*          Throughput versus number of concurrent streams       */
+/*                                                               */
+/*===============================================================*/
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <exception>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+#include "frame_source.h"
+#include "scaling.h"
+
+// User plus system CPU time of the whole process so far, in seconds.
+static double cpu_seconds(void) {
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+
+	return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6
+		+ usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+}
+
+int run_scaling(const app_options& options, const backend_factory& open_backend, const stream_runner& run) {
+	if (options.inputs.empty()) {
+		std::cerr << "No inputs to replay" << std::endl;
+		return -1;
+	}
+
+	std::ofstream csv(options.scale_file.c_str());
+	if (!csv) {
+		std::cerr << "Unable to open scaling file: " << options.scale_file << std::endl;
+		return -1;
+	}
+
+	unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+
+	const char *header = "streams,frames,system_fps,stream_fps_mean,stream_fps_min,"
+		"cpu_percent,cpu_utilisation,latency_p50_ms,latency_p90_ms,latency_p99_ms,latency_max_ms";
+	csv << header << std::endl;
+	std::cout << header << std::endl;
+
+	for (int k = 1; k <= options.scale; k++) {
+		std::vector<cv::VideoCapture*> video;
+		for (int i = 0; i < k; i++) {
+			const std::string &name = options.inputs[i % options.inputs.size()];
+
+			video.push_back(open_video(name, options));
+			if (!video.back()->isOpened()) {
+				std::cerr << "Unable to open video file: " << name << std::endl;
+				for (unsigned j = 0; j < video.size(); j++) delete video[j];
+				return -1;
+			}
+		}
+
+		// Sized for these K streams, as a normal run of K inputs would be.
+		DetectorBackend *backend;
+		try {
+			backend = open_backend(k);
+		}
+		catch (std::exception &e) {
+			std::cerr << "Unable to start the detector: " << e.what() << std::endl;
+			for (unsigned j = 0; j < video.size(); j++) delete video[j];
+			return -1;
+		}
+		int depth = backend->depth(options, k);
+
+		std::vector<BenchStats> bench(k);
+		std::vector<StreamStats> stats(k);
+		std::vector<std::thread> streams(k);
+
+		double cpu_start = cpu_seconds();
+		timestamp start = std::chrono::steady_clock::now();
+
+		for (int i = 0; i < k; i++) {
+			streams[i] = std::thread(run, std::ref(*backend), depth, i, std::ref(*video[i]), std::ref(bench[i]), std::ref(stats[i]));
+		}
+		for (int i = 0; i < k; i++) {
+			streams[i].join();
+			delete video[i];
+		}
+
+		delete backend;
+
+		double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		double cpu = cpu_seconds() - cpu_start;
+
+		BenchStats all;
+		double fps_sum = 0, fps_min = 0;
+		for (int i = 0; i < k; i++) {
+			all.merge(bench[i]);
+			fps_sum += bench[i].fps();
+			fps_min = i ? std::min(fps_min, bench[i].fps()) : bench[i].fps();
+		}
+
+		const LatencyHistogram &latency = all.stage(STAGE_TOTAL);
+		double cpu_percent = (wall > 0) ? 100 * cpu / wall : 0;
+
+		std::stringstream row;
+		row << std::fixed << std::setprecision(3)
+			<< k << "," << all.frames() << "," << all.fps() << "," << fps_sum / k << "," << fps_min << ","
+			<< cpu_percent << "," << cpu_percent / 100 / cores << ","
+			<< latency.percentile(0.50) / 1e6 << "," << latency.percentile(0.90) / 1e6 << ","
+			<< latency.percentile(0.99) / 1e6 << "," << latency.max() / 1e6;
+
+		csv << row.str() << std::endl;
+		std::cout << row.str() << std::endl;
+	}
+
+	return 0;
+}
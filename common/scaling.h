@@ -0,0 +1,34 @@
+#ifndef SCALING
+#define SCALING
+
+/*===============================================================*/
+/*                                                               */
+/*                           scaling.h                           */
+/*                                                               */
+/*          Throughput versus number of concurrent streams       */
+/*                                                               */
+/*===============================================================*/
+
+#include <functional>
+
+#include <opencv2/videoio.hpp>
+
+#include "bench.h"
+#include "detector.h"
+#include "options.h"
+#include "stream_stats.h"
+
+// Runs one headless stream to completion on the calling thread, with up to
+// `depth` frames in flight on `backend`, recording into `bench` and `stats`.
+// Each target wraps its own pipeline in one.
+typedef std::function<void(DetectorBackend& backend, int depth, int stream, cv::VideoCapture& video,
+	BenchStats& bench, StreamStats& stats)> stream_runner;
+
+// Replay the inputs as K = 1..options.scale concurrent streams (stream i
+// reads input i modulo the number of inputs, from its start) and write one
+// CSV row per K to options.scale_file: frames, system and per-stream FPS,
+// CPU utilisation and end-to-end latency percentiles. Every K runs on a
+// backend of its own from `open_backend`, at the depth it gives for K streams.
+int run_scaling(const app_options& options, const backend_factory& open_backend, const stream_runner& run);
+
+#endif
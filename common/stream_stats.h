@@ -0,0 +1,86 @@
+#ifndef STREAM_STATS
+#define STREAM_STATS
+
+/*===============================================================*/
+/*                                                               */
+/*                        stream_stats.h                         */
+/*                                                               */
+/*           Per-stream frame, drop and latency counters         */
+/*                                                               */
+/*===============================================================*/
+
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#include "frame_source.h"
+
+// Updated by the pipeline threads of one stream, read by anyone.
+class StreamStats {
+public:
+	StreamStats(): frames(0), dropped(0), allocations(0), latency_sum(0), latency_last(0), latency_max(0) {}
+
+	// A frame captured at `captured` has its detection result ready.
+	void record(timestamp captured) {
+		unsigned long long us = std::chrono::duration_cast<std::chrono::microseconds>(
+			std::chrono::steady_clock::now() - captured).count();
+
+		frames++;
+		latency_sum += us;
+		latency_last = us;
+		if (us > latency_max) latency_max = us;
+	}
+
+	// Latency of the most recent frame, in milliseconds.
+	float last_latency_ms(void) const { return latency_last / 1000.0f; }
+
+	void print(const std::string& name) const {
+		unsigned long n = frames;
+
+		std::cout << "[" << name << "] frames: " << n << " dropped: " << dropped;
+		if (n) {
+			std::cout << std::fixed << std::setprecision(2)
+				<< " latency avg: " << (latency_sum / (double) n) / 1000.0 << " ms"
+				<< " max: " << latency_max / 1000.0 << " ms"
+				<< " allocations/frame: " << allocations / (double) n;
+		}
+		std::cout << std::endl;
+	}
+
+	std::atomic<unsigned long> frames;
+	std::atomic<unsigned long> dropped;
+	// Frame buffer allocations after the first frame; zero in steady state.
+	std::atomic<unsigned long> allocations;
+
+private:
+	std::atomic<unsigned long long> latency_sum;
+	std::atomic<unsigned long long> latency_last;
+	std::atomic<unsigned long long> latency_max;
+};
+
+// Average frame rate for the on-screen overlay: frames since the first
+// result over the steady-clock time since then.
+class FrameRate {
+public:
+	FrameRate(): n(0) {}
+
+	// A result is ready; returns the rate so far (0 for the first one).
+	float tick(void) {
+		timestamp now = std::chrono::steady_clock::now();
+		if (!n++) {
+			first = now;
+			return 0.0f;
+		}
+
+		double seconds = std::chrono::duration<double>(now - first).count();
+		return (seconds > 0) ? (n - 1) / seconds : 0.0f;
+	}
+
+private:
+	unsigned long n;
+	timestamp first;
+};
+
+#endif
@@ -0,0 +1,149 @@
+/*===============================================================*/
+/*                                                               */
+/*                           trace.cpp                           */
+/*                                                               */
+/*        Chrome Trace Event export of the frame pipeline        */
+/*                                                               */
+/*===============================================================*/
+
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+#include "trace.h"
+
+// Events a thread keeps at most, about 40 MB; later ones are counted only.
+static const unsigned long MAX_EVENTS = 1 << 20;
+
+typedef struct {
+	const char *stage;
+	int stream;
+	long frame;
+	long long begin;	// nanoseconds since trace_enable()
+	long long end;
+} trace_event;
+
+typedef struct {
+	std::string name;
+	// Blocks are only ever appended, so recording never moves earlier events.
+	std::deque<trace_event> events;
+	unsigned long dropped;
+} thread_trace;
+
+bool trace_active = false;
+
+static std::chrono::steady_clock::time_point origin;
+
+// Buffers of every thread that recorded something. They outlive their
+// threads so the trace can be written after the streams are joined.
+static std::mutex registry_lock;
+static std::vector<thread_trace*> registry;
+
+static thread_trace *thread_buffer(void) {
+	static thread_local thread_trace *buffer = NULL;
+
+	if (!buffer) {
+		buffer = new thread_trace;
+		buffer->dropped = 0;
+
+		std::lock_guard<std::mutex> lock(registry_lock);
+		registry.push_back(buffer);
+	}
+	return buffer;
+}
+
+void trace_enable(void) {
+	origin = std::chrono::steady_clock::now();
+	trace_active = true;
+}
+
+void trace_thread(const std::string& name) {
+	if (!tracing()) return;
+
+	thread_buffer()->name = name;
+}
+
+void trace_span(const char *stage, int stream, long frame,
+	std::chrono::steady_clock::time_point begin, std::chrono::steady_clock::time_point end) {
+	if (!tracing()) return;
+
+	thread_trace *buffer = thread_buffer();
+	if (buffer->events.size() >= MAX_EVENTS) {
+		buffer->dropped++;
+		return;
+	}
+
+	trace_event event;
+	event.stage = stage;
+	event.stream = stream;
+	event.frame = frame;
+	event.begin = std::chrono::duration_cast<std::chrono::nanoseconds>(begin - origin).count();
+	event.end = std::chrono::duration_cast<std::chrono::nanoseconds>(end - origin).count();
+	buffer->events.push_back(event);
+}
+
+static std::string json_string(const std::string& text) {
+	std::string out = "\"";
+	for (unsigned i = 0; i < text.size(); i++) {
+		unsigned char c = text[i];
+		if (c == '"' || c == '\\') out += '\\';
+		out += (c < 0x20) ? ' ' : (char) c;
+	}
+	return out + "\"";
+}
+
+// Trace Event timestamps are in microseconds; keep the nanoseconds.
+static void write_us(std::ostream& out, long long ns) {
+	if (ns < 0) {
+		out << '-';
+		ns = -ns;
+	}
+	out << ns / 1000 << '.' << (char) ('0' + ns / 100 % 10) << (char) ('0' + ns / 10 % 10) << (char) ('0' + ns % 10);
+}
+
+bool write_trace(const std::string& filename) {
+	std::ofstream out(filename);
+	if (!out.is_open()) {
+		std::cerr << "Unable to open trace file: " << filename << std::endl;
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(registry_lock);
+
+	unsigned long dropped = 0;
+
+	out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"face detection\"}}";
+
+	for (unsigned t = 0; t < registry.size(); t++) {
+		const thread_trace &buffer = *registry[t];
+		int tid = t + 1;
+
+		std::string name = buffer.name.empty() ? "thread " + std::to_string(tid) : buffer.name;
+		out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << tid
+			<< ",\"args\":{\"name\":" << json_string(name) << "}}";
+		out << ",\n{\"name\":\"thread_sort_index\",\"ph\":\"M\",\"pid\":1,\"tid\":" << tid
+			<< ",\"args\":{\"sort_index\":" << tid << "}}";
+
+		for (std::deque<trace_event>::const_iterator e = buffer.events.begin(); e != buffer.events.end(); ++e) {
+			out << ",\n{\"name\":\"" << e->stage << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << tid << ",\"ts\":";
+			write_us(out, e->begin);
+			out << ",\"dur\":";
+			write_us(out, e->end - e->begin);
+			out << ",\"args\":{";
+			if (e->stream >= 0) out << "\"stream\":" << e->stream << (e->frame >= 0 ? "," : "");
+			if (e->frame >= 0) out << "\"frame\":" << e->frame;
+			out << "}}";
+		}
+
+		dropped += buffer.dropped;
+	}
+
+	out << "\n]}\n";
+
+	if (dropped) std::cerr << "Trace buffers full, " << dropped << " events dropped" << std::endl;
+
+	return out.good();
+}
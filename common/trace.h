@@ -0,0 +1,58 @@
+#ifndef TRACE
+#define TRACE
+
+/*===============================================================*/
+/*                                                               */
+/*                            trace.h                            */
+/*                                                               */
+/*        Chrome Trace Event export of the frame pipeline        */
+/*                                                               */
+/*===============================================================*/
+
+#include <chrono>
+#include <string>
+
+// With --trace, every thread records a begin/end pair for each stage of each
+// frame it handles into its own buffer, which only that thread appends to.
+// The buffers are written as Chrome Trace Event JSON once the streams are
+// done; open it in Perfetto (ui.perfetto.dev) or chrome://tracing. Until
+// trace_enable() is called, every entry point returns after a single branch.
+
+extern bool trace_active;
+
+inline bool tracing(void) { return trace_active; }
+
+// Start recording. Call before any pipeline thread is started.
+void trace_enable(void);
+
+// Name the calling thread's track, e.g. "submitter 0".
+void trace_thread(const std::string& name);
+
+// Record that the calling thread spent [begin, end] in `stage` for a frame
+// of a stream; stream or frame -1 when not known. `stage` must be a string
+// literal or otherwise outlive the trace.
+void trace_span(const char *stage, int stream, long frame,
+	std::chrono::steady_clock::time_point begin, std::chrono::steady_clock::time_point end);
+
+// Records the lifetime of the scope as a span.
+class TraceScope {
+public:
+	TraceScope(const char *stage, int stream, long frame): stage(stage), stream(stream), frame(frame) {
+		if (tracing()) begin = std::chrono::steady_clock::now();
+	}
+
+	~TraceScope(void) {
+		if (tracing()) trace_span(stage, stream, frame, begin, std::chrono::steady_clock::now());
+	}
+
+private:
+	const char *stage;
+	int stream;
+	long frame;
+	std::chrono::steady_clock::time_point begin;
+};
+
+// Write everything recorded so far. Call once the traced threads are done.
+bool write_trace(const std::string& filename);
+
+#endif
@@ -0,0 +1,78 @@
+/*===============================================================*/
+/*                                                               */
+/*                       video_encoder.cpp                       */
+/*                                                               */
+/*               One encoder thread per output stream            */
+/*                                                               */
+/*===============================================================*/
+
+#include <cctype>
+
+#include "trace.h"
+#include "video_encoder.h"
+
+std::string output_filename(const std::string& dir, int index, const std::string& input) {
+	std::string stem = input.substr(input.find_last_of('/') + 1);
+
+	size_t dot = stem.find_last_of('.');
+	if (dot != std::string::npos && dot > 0) stem = stem.substr(0, dot);
+
+	// Cameras and URLs make poor file names.
+	for (unsigned i = 0; i < stem.size(); i++) {
+		if (!isalnum((unsigned char) stem[i]) && stem[i] != '-' && stem[i] != '_') stem[i] = '_';
+	}
+
+	return dir + "/video-" + std::to_string(index) + (stem.empty() ? "" : "-" + stem) + ".mp4";
+}
+
+VideoEncoder::VideoEncoder(const std::string& filename, double fps, cv::Size size, int queue_size):
+	filename(filename), writer(filename, cv::VideoWriter::fourcc('M','P','4','V'), fps, size), queue(queue_size) {
+	opened = writer.isOpened();
+	queue.monitor("encode " + filename);
+	worker = std::thread(&VideoEncoder::encode, this);
+}
+
+VideoEncoder::~VideoEncoder(void) {
+	close();
+}
+
+void VideoEncoder::write(cv::Mat& frame, FramePool* pool) {
+	encode_job job;
+	job.frame = std::move(frame);
+	job.pool = pool;
+
+	TraceScope trace("encode wait", -1, -1);
+	queue.enqueue(std::move(job));
+}
+
+void VideoEncoder::close(void) {
+	if (!worker.joinable()) return;
+
+	// An empty frame ends the stream.
+	encode_job job;
+	job.pool = NULL;
+	queue.enqueue(std::move(job));
+
+	worker.join();
+	writer.release();
+}
+
+void VideoEncoder::encode(void) {
+	trace_thread("encoder " + filename);
+
+	for (long i = 0; ; i++) {
+		encode_job job;
+		{
+			TraceScope trace("queue wait", -1, i);
+			job = queue.dequeue();
+		}
+		if (job.frame.empty()) break;
+
+		{
+			TraceScope trace("encode", -1, i);
+			if (opened) writer.write(job.frame);
+		}
+
+		if (job.pool) job.pool->release(job.frame);
+	}
+}
@@ -0,0 +1,58 @@
+#ifndef VIDEO_ENCODER
+#define VIDEO_ENCODER
+
+/*===============================================================*/
+/*                                                               */
+/*                        video_encoder.h                        */
+/*                                                               */
+/*               One encoder thread per output stream            */
+/*                                                               */
+/*===============================================================*/
+
+#include <string>
+#include <thread>
+
+#include <opencv2/videoio.hpp>
+
+#include "frame_pool.h"
+#include "safe_queue.h"
+
+// Output file for the `index`-th (1 based) input, named after the input.
+std::string output_filename(const std::string& dir, int index, const std::string& input);
+
+// Encodes one output video on its own thread, so streams are encoded in
+// parallel and detection of the next frame overlaps encoding of this one.
+class VideoEncoder {
+public:
+	static const int QUEUE_SIZE = 8;
+
+	VideoEncoder(const std::string& filename, double fps, cv::Size size, int queue_size = QUEUE_SIZE);
+
+	~VideoEncoder(void);
+
+	bool isOpened(void) const { return opened; }
+
+	// Queue a frame for encoding; blocks while the encoder is `queue_size`
+	// frames behind. If `pool` is given the frame is released to it once
+	// written. The caller's reference is taken over.
+	void write(cv::Mat& frame, FramePool* pool);
+
+	// Encode everything queued and close the file. Called by the destructor.
+	void close(void);
+
+private:
+	typedef struct {
+		cv::Mat frame;
+		FramePool *pool;
+	} encode_job;
+
+	void encode(void);
+
+	std::string filename;
+	cv::VideoWriter writer;
+	bool opened;
+	SafeQueue<encode_job> queue;
+	std::thread worker;
+};
+
+#endif
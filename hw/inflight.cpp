@@ -0,0 +1,198 @@
+/*===============================================================*/
+/*                                                               */
+/*                          inflight.cpp                         */
+/*                                                               */
+/*      Adaptive limit on the requests a stream keeps in flight   */
+/*                                                               */
+/*===============================================================*/
+
+#include <algorithm>
+#include <iostream>
+
+#include "inflight.h"
+
+// A window is never shorter than this, so slow streams still see a few
+// completions per decision.
+static const std::chrono::milliseconds MIN_WINDOW(20);
+
+// Requests a stream may keep waiting on the accelerator: enough that a device
+// never runs dry between two of them, few enough that they add little latency.
+static const double MIN_QUEUED = 1.0;
+static const double MAX_QUEUED = 3.0;
+
+InflightController::InflightController(int max_depth, std::chrono::steady_clock::duration target):
+	max_depth(std::max(1, max_depth)),
+	target_ns(std::chrono::duration_cast<std::chrono::nanoseconds>(target).count()),
+	in_flight(0), window_completions(0), window_latency_ns(0), saturated(false), min_latency_ns(0), last_latency_ns(0),
+	n_grown(0), n_shrunk(0), n_cut(0), n_held(0), monitored(false) {
+	// Start with one request, so the first windows see the latency of an
+	// idle accelerator, and let the measurements deepen it.
+	depth = 1;
+	lowest = highest = depth;
+	window_start = std::chrono::steady_clock::now();
+
+	telemetry.depth = 0;
+	telemetry.high_water = 0;
+	telemetry.capacity = depth;
+	telemetry.enqueued = 0;
+	telemetry.dequeued = 0;
+	telemetry.enqueue_blocked = 0;
+	telemetry.dequeue_waited = 0;
+	telemetry.enqueue_blocked_time = std::chrono::steady_clock::duration::zero();
+	telemetry.dequeue_wait_time = std::chrono::steady_clock::duration::zero();
+}
+
+InflightController::~InflightController(void) {
+	if (monitored) unmonitor_queue(this);
+}
+
+void InflightController::monitor(const std::string& name) {
+	monitor_queue(this, name, [this]() { return stats(); }, [this]() { return decisions(); });
+	monitored = true;
+}
+
+queue_stats InflightController::stats(void) {
+	std::lock_guard<std::mutex> lock(m);
+	queue_stats s = telemetry;
+	s.depth = in_flight;
+	s.capacity = depth;
+	return s;
+}
+
+limit_stats InflightController::decisions(void) {
+	std::lock_guard<std::mutex> lock(m);
+	limit_stats s;
+	s.lowest = lowest;
+	s.highest = highest;
+	s.grown = n_grown;
+	s.shrunk = n_shrunk;
+	s.cut = n_cut;
+	s.held = n_held;
+	s.window_latency = std::chrono::nanoseconds(last_latency_ns);
+	s.lowest_latency = std::chrono::nanoseconds(min_latency_ns);
+	return s;
+}
+
+int InflightController::limit(void) {
+	std::lock_guard<std::mutex> lock(m);
+	return depth;
+}
+
+std::chrono::steady_clock::duration InflightController::latency(void) {
+	std::lock_guard<std::mutex> lock(m);
+	if (!in_flight) return std::chrono::steady_clock::duration::zero();
+
+	// Without completions, e.g. while every frame spills, no window closes
+	// and the last mean says nothing about the requests in flight.
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	if (now - window_start <= MIN_WINDOW + 2 * std::chrono::nanoseconds(last_latency_ns)) {
+		return std::chrono::nanoseconds(last_latency_ns);
+	}
+	return now - started.front();
+}
+
+void InflightController::take(void) {
+	in_flight++;
+	started.push_back(std::chrono::steady_clock::now());
+	if (in_flight >= depth) saturated = true;
+
+	telemetry.enqueued++;
+	telemetry.high_water = std::max(telemetry.high_water, (unsigned long) in_flight);
+}
+
+void InflightController::acquire(void) {
+	std::unique_lock<std::mutex> lock(m);
+	if (in_flight >= depth) {
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		while (in_flight >= depth) c.wait(lock);
+
+		telemetry.enqueue_blocked++;
+		telemetry.enqueue_blocked_time += std::chrono::steady_clock::now() - start;
+	}
+
+	take();
+}
+
+bool InflightController::try_acquire(void) {
+	std::lock_guard<std::mutex> lock(m);
+	if (in_flight >= depth) return false;
+
+	take();
+	return true;
+}
+
+void InflightController::cancel(void) {
+	{
+		std::lock_guard<std::mutex> lock(m);
+		in_flight--;
+		started.pop_front();
+		telemetry.dequeued++;
+	}
+	c.notify_one();
+}
+
+void InflightController::complete(std::chrono::steady_clock::duration latency) {
+	std::unique_lock<std::mutex> lock(m);
+	in_flight--;
+	started.pop_front();
+	telemetry.dequeued++;
+
+	window_completions++;
+	window_latency_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(latency).count();
+
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	if (window_completions >= (unsigned long) depth && now - window_start >= MIN_WINDOW) adjust(now);
+
+	lock.unlock();
+	c.notify_one();
+}
+
+void InflightController::adjust(std::chrono::steady_clock::time_point now) {
+	long long mean = window_latency_ns / window_completions;
+	last_latency_ns = mean;
+
+	// The lowest mean follows a slower accelerator up, slowly.
+	if (!min_latency_ns || mean < min_latency_ns) min_latency_ns = mean;
+	else min_latency_ns += (mean - min_latency_ns) / 64;
+
+	// By Little's law, the requests that spent their extra latency waiting
+	// behind others rather than being worked on.
+	double queued = depth * (mean - min_latency_ns) / (double) mean;
+	int previous = depth;
+
+	if (target_ns && mean > target_ns) {
+		depth = std::min(depth - 1, (int) (depth * (double) target_ns / mean));
+		n_cut++;
+	}
+	else if (queued > MAX_QUEUED && depth > 1) {
+		depth--;
+		n_shrunk++;
+	}
+	else if (saturated && queued < MIN_QUEUED && depth < max_depth &&
+		(!target_ns || mean < target_ns)) {
+		depth++;
+		n_grown++;
+	}
+	else n_held++;
+
+	depth = std::max(1, std::min(depth, max_depth));
+	lowest = std::min(lowest, depth);
+	highest = std::max(highest, depth);
+
+	if (depth > previous) c.notify_all();
+
+	window_start = now;
+	window_completions = 0;
+	window_latency_ns = 0;
+	saturated = in_flight >= depth;
+}
+
+void InflightController::print(const std::string& name) {
+	std::lock_guard<std::mutex> lock(m);
+
+	std::cout << "[" << name << "] in flight: limit " << depth << " (" << lowest << ".." << highest
+		<< " of " << max_depth << "), " << n_grown << " grown, " << n_shrunk << " shrunk, "
+		<< n_cut << " cut for latency, " << n_held << " held";
+	if (min_latency_ns) std::cout << ", lowest latency " << min_latency_ns / 1e6 << " ms";
+	std::cout << std::endl;
+}
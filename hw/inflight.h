@@ -0,0 +1,113 @@
+#ifndef INFLIGHT
+#define INFLIGHT
+
+/*===============================================================*/
+/*                                                               */
+/*                           inflight.h                          */
+/*                                                               */
+/*      Adaptive limit on the requests a stream keeps in flight   */
+/*                                                               */
+/*===============================================================*/
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+
+#include "queue_stats.h"
+
+// Decides how many requests of one stream may be on the accelerator at once.
+// Completions are measured in windows of at least `depth` requests and 20 ms:
+// their mean submit-to-completion latency, and the lowest such mean seen,
+// which is what the accelerator takes without queueing. From the two follows
+// how many of the requests in flight were only waiting for a device.
+//
+// After each window the limit is
+//   cut       in proportion, when latency is above the target;
+//   shrunk    by one, when more than 3 requests were waiting;
+//   grown     by one, when fewer than 1 was waiting and the stream used its
+//             whole limit;
+//   held      otherwise.
+// It starts at 1 and never exceeds `max_depth`, the size of the stream's
+// buffer pool.
+class InflightController {
+public:
+	// `target` is the latency to stay under; zero for none.
+	InflightController(int max_depth, std::chrono::steady_clock::duration target);
+
+	~InflightController(void);
+
+	// Publish in-flight requests as queue `name` (see queue_stats.h): depth
+	// is the requests in flight, capacity the current limit, and blocked
+	// enqueues are submissions held back by it. The range of the limit, the
+	// decisions and the window latencies are exported as that queue's limit.
+	void monitor(const std::string& name);
+
+	// Wait until one more request may be submitted.
+	void acquire(void);
+
+	// Take a slot only if one is free right away.
+	bool try_acquire(void);
+
+	// A request finished `latency` after it was submitted.
+	void complete(std::chrono::steady_clock::duration latency);
+
+	// A request never reached the accelerator or failed there; its slot is
+	// freed without a measurement.
+	void cancel(void);
+
+	int limit(void);
+
+	// How long a request takes now: the mean latency of the last window
+	// while that is recent, else how long the oldest request in flight has
+	// waited so far; zero with none in flight, as an idle accelerator is not
+	// slow whatever it measured before.
+	std::chrono::steady_clock::duration latency(void);
+
+	// The final limit, its range and the decisions taken.
+	void print(const std::string& name);
+
+private:
+	// With the lock held.
+	void take(void);
+
+	void adjust(std::chrono::steady_clock::time_point now);
+
+	queue_stats stats(void);
+
+	limit_stats decisions(void);
+
+	std::mutex m;
+	std::condition_variable c;
+
+	int max_depth;
+	long long target_ns;
+
+	int depth;		// requests allowed in flight
+	int in_flight;
+	// Submission times of the requests in flight, oldest first; requests
+	// mostly finish in that order, so each one done drops the oldest.
+	std::deque<std::chrono::steady_clock::time_point> started;
+	int lowest;
+	int highest;
+
+	// The current window.
+	std::chrono::steady_clock::time_point window_start;
+	unsigned long window_completions;
+	long long window_latency_ns;
+	bool saturated;		// in flight reached the limit
+
+	long long min_latency_ns;	// lowest window mean, 0 before the first
+	long long last_latency_ns;
+
+	unsigned long n_grown;
+	unsigned long n_shrunk;
+	unsigned long n_cut;
+	unsigned long n_held;
+
+	queue_stats telemetry;
+	bool monitored;
+};
+
+#endif
@@ -0,0 +1,286 @@
+/*===============================================================*/
+/*                                                               */
+/*                       inflight_check.cpp                      */
+/*                                                               */
+/*    The in-flight controller against the local accelerator     */
+/*                                                               */
+/*===============================================================*/
+
+// Drives one stream's InflightController with face-detect requests on the
+// in-process accelerator stand-in (hw/local) at a fixed number of devices and
+// rate, the way the scheduler and a dispatcher do: the submitter takes a slot
+// for every request, the completer polls the requests in flight and reports
+// each one's latency up to when it was first seen done. Checks that
+//   - without a target the limit settles where the devices stay busy and few
+//     requests wait, DEVICES..DEVICES + 4, at close to their full rate;
+//   - with a target below the latency of that queue, the limit backs off and
+//     the mean latency stays near the target;
+//   - after a latency spike, during which frames spill to the CPU as in the
+//     scheduler, frames go back to the accelerator once it has caught up;
+//   - the decisions taken are exported with the telemetry.
+// `make check` builds and runs it; it exits with -1 if a check fails.
+
+#include <stdlib.h>
+
+#include <chrono>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <list>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <inaccel/coral>
+
+#include "inflight.h"
+#include "safe_queue.h"
+#include "utils.h"
+
+typedef std::chrono::steady_clock::time_point timestamp;
+
+static const int DEVICES = 2;
+static const int FPS = 20;		// per device: 50 ms a request, far more than the cascade takes
+static const int MAX_DEPTH = 16;
+static const int REQUESTS = 240;
+
+// How long the completer blocks on the oldest request when none is done.
+static const std::chrono::microseconds COMPLETION_POLL(200);
+
+// The spike: requests queued at once by another user of the devices, eight
+// times the service time on each, while this stream sends a frame every
+// FRAME_INTERVAL, a quarter of what the devices take, and spills it to an
+// always free CPU when the accelerator's latency is over SPILL_LATENCY.
+static const int BURST = 16;
+static const int SPIKE_FRAMES = 40;
+static const std::chrono::milliseconds FRAME_INTERVAL(100);
+static const std::chrono::milliseconds SPILL_LATENCY(150);
+
+typedef struct {
+	inaccel::vector<unsigned char> input;
+	inaccel::vector<int> result_x;
+	inaccel::vector<int> result_y;
+	inaccel::vector<int> result_w;
+	inaccel::vector<int> result_h;
+	inaccel::vector<int> res_size;
+
+	std::future<void> response;
+	timestamp submitted;
+} request_slot;
+
+// The second half of a run, once the limit had time to settle.
+typedef struct {
+	int limit;
+	double fps;
+	double latency_ms;
+	std::string metrics;	// the telemetry at the end
+} run_result;
+
+// A blank frame, so the devices spend their time on the configured rate
+// rather than on the cascade.
+static request_slot *new_slot(void) {
+	request_slot *slot = new request_slot;
+	slot->input.resize(KERNEL_WIDTH * KERNEL_HEIGHT, 0);
+	slot->result_x.resize(RESULT_SIZE);
+	slot->result_y.resize(RESULT_SIZE);
+	slot->result_w.resize(RESULT_SIZE);
+	slot->result_h.resize(RESULT_SIZE);
+	slot->res_size.resize(1);
+	return slot;
+}
+
+static void submit(request_slot *slot) {
+	inaccel::request facedetect("edu.cornell.ece.zhang.rosetta.face-detect");
+	facedetect.arg(slot->input).arg(slot->result_x).arg(slot->result_y)
+		.arg(slot->result_w).arg(slot->result_h).arg(slot->res_size);
+
+	slot->submitted = std::chrono::steady_clock::now();
+	slot->response = inaccel::submit(facedetect);
+}
+
+// The dispatcher's part: poll the requests taken from `submitted` until a
+// NULL, report each one's latency up to when it was first seen done and hand
+// it to `done`.
+static void complete_all(InflightController& inflight, SafeQueue<request_slot*>& submitted,
+	const std::function<void(request_slot *slot, timestamp now)>& done) {
+	std::list<request_slot*> pending;
+	bool finished = false;
+
+	while (!finished || !pending.empty()) {
+		request_slot *slot;
+		while (!finished && submitted.try_dequeue(slot)) {
+			if (slot) pending.push_back(slot);
+			else finished = true;
+		}
+
+		bool progress = false;
+		timestamp now = std::chrono::steady_clock::now();
+
+		for (std::list<request_slot*>::iterator it = pending.begin(); it != pending.end(); ) {
+			request_slot *slot = *it;
+			if (slot->response.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+				it++;
+				continue;
+			}
+
+			slot->response.get();
+			inflight.complete(now - slot->submitted);
+			done(slot, now);
+
+			it = pending.erase(it);
+			progress = true;
+		}
+
+		if (progress) continue;
+
+		if (!pending.empty()) pending.front()->response.wait_for(COMPLETION_POLL);
+		else std::this_thread::sleep_for(COMPLETION_POLL);
+	}
+}
+
+static run_result run(const std::string& name, std::chrono::steady_clock::duration target) {
+	InflightController inflight(MAX_DEPTH, target);
+	inflight.monitor(name);
+
+	// Every request in flight has its own buffers; the limit never allows
+	// more than there are.
+	SafeQueue<request_slot*> free_slots;
+	for (int i = 0; i < MAX_DEPTH; i++) free_slots.enqueue(new_slot());
+
+	// NULL ends the run.
+	SafeQueue<request_slot*> submitted;
+
+	timestamp half;
+	unsigned long half_completions = 0;
+	long long half_latency_ns = 0;
+	int completions = 0;
+
+	std::thread completer(complete_all, std::ref(inflight), std::ref(submitted), [&](request_slot *slot, timestamp now) {
+		if (++completions == REQUESTS / 2) half = now;
+		else if (completions > REQUESTS / 2) {
+			half_completions++;
+			half_latency_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(now - slot->submitted).count();
+		}
+
+		free_slots.enqueue(slot);
+	});
+
+	for (int i = 0; i < REQUESTS; i++) {
+		inflight.acquire();
+		request_slot *slot = free_slots.dequeue();
+
+		submit(slot);
+		submitted.enqueue(slot);
+	}
+
+	submitted.enqueue(NULL);
+	completer.join();
+
+	run_result result;
+	result.limit = inflight.limit();
+	result.fps = half_completions / std::chrono::duration<double>(std::chrono::steady_clock::now() - half).count();
+	result.latency_ms = half_latency_ns / 1e6 / half_completions;
+	result.metrics = queue_metrics();
+
+	inflight.print(name);
+	std::cout << "[" << name << "] " << result.fps << " requests/s, mean latency " << result.latency_ms << " ms" << std::endl;
+
+	for (int i = 0; i < MAX_DEPTH; i++) delete free_slots.dequeue();
+
+	return result;
+}
+
+// The share of the frames in the second half of the spike run, well after
+// the burst drained, that went to the accelerator.
+static double spike_run(const std::string& name) {
+	InflightController inflight(MAX_DEPTH, std::chrono::steady_clock::duration::zero());
+
+	SafeQueue<request_slot*> free_slots;
+	for (int i = 0; i < MAX_DEPTH; i++) free_slots.enqueue(new_slot());
+
+	// Straight to the devices, past this stream's controller.
+	std::vector<request_slot*> burst;
+	for (int i = 0; i < BURST; i++) {
+		burst.push_back(new_slot());
+		submit(burst.back());
+	}
+
+	SafeQueue<request_slot*> submitted;
+	std::thread completer(complete_all, std::ref(inflight), std::ref(submitted), [&](request_slot *slot, timestamp now) {
+		free_slots.enqueue(slot);
+	});
+
+	int n_accelerator = 0, n_spilled_latency = 0, n_spilled_depth = 0, late_accelerator = 0;
+	timestamp start = std::chrono::steady_clock::now();
+
+	// The scheduler's choice for every frame, with a CPU that is always free.
+	for (int i = 0; i < SPIKE_FRAMES; i++) {
+		std::this_thread::sleep_until(start + i * FRAME_INTERVAL);
+
+		if (inflight.latency() > SPILL_LATENCY) n_spilled_latency++;
+		else if (!inflight.try_acquire()) n_spilled_depth++;
+		else {
+			request_slot *slot = free_slots.dequeue();
+			submit(slot);
+			submitted.enqueue(slot);
+
+			n_accelerator++;
+			if (i >= SPIKE_FRAMES / 2) late_accelerator++;
+		}
+	}
+
+	submitted.enqueue(NULL);
+	completer.join();
+
+	for (int i = 0; i < BURST; i++) {
+		burst[i]->response.wait();
+		delete burst[i];
+	}
+	for (int i = 0; i < MAX_DEPTH; i++) delete free_slots.dequeue();
+
+	inflight.print(name);
+	std::cout << "[" << name << "] accelerator: " << n_accelerator << " frames, CPU: " << n_spilled_latency
+		<< " over the spill latency, " << n_spilled_depth << " over the in-flight limit" << std::endl;
+
+	return late_accelerator / (double) (SPIKE_FRAMES - SPIKE_FRAMES / 2);
+}
+
+static bool check(bool passed, const std::string& what) {
+	std::cout << (passed ? "ok:   " : "FAIL: ") << what << std::endl;
+	return passed;
+}
+
+int main(int argc, char *argv[]) {
+	// Read by the stand-in on the first request.
+	setenv("INACCEL_LOCAL_DEVICES", std::to_string(DEVICES).c_str(), 1);
+	setenv("INACCEL_LOCAL_FPS", std::to_string(FPS).c_str(), 1);
+	setenv("INACCEL_LOCAL_LATENCY_US", "0", 1);
+
+	double service_ms = 1000.0 / FPS;
+	bool passed = true;
+
+	run_result free_run = run("no target", std::chrono::steady_clock::duration::zero());
+
+	passed &= check(free_run.limit >= DEVICES && free_run.limit <= DEVICES + 4,
+		"without a target the limit settles at " + std::to_string(DEVICES) + ".." + std::to_string(DEVICES + 4));
+	passed &= check(free_run.fps >= 0.9 * DEVICES * FPS, "without a target the devices stay busy");
+
+	// It grew from 1 on the way there.
+	std::string grown = "facedetect_limit_decisions_total{queue=\"no target\",decision=\"grown\"} ";
+	size_t exported = free_run.metrics.find(grown);
+	passed &= check(exported != std::string::npos && atoi(free_run.metrics.c_str() + exported + grown.size()) >= DEVICES - 1,
+		"the limit's decisions are exported with the telemetry");
+
+	// A third request on two devices already averages more than this.
+	double target_ms = 1.2 * service_ms;
+	run_result target_run = run("target " + std::to_string((int) target_ms) + " ms",
+		std::chrono::microseconds((long long) (target_ms * 1000)));
+
+	passed &= check(target_run.limit <= DEVICES + 1, "under the latency target the limit backs off to at most " + std::to_string(DEVICES + 1));
+	passed &= check(target_run.latency_ms <= 1.25 * target_ms, "under the latency target the mean latency stays near it");
+
+	double recovered = spike_run("spike");
+	passed &= check(recovered >= 0.9, "after a latency spike the frames go back to the accelerator");
+
+	return passed ? 0 : -1;
+}
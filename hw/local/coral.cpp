@@ -0,0 +1,266 @@
+/*===============================================================*/
+/*                                                               */
+/*                           coral.cpp                           */
+/*                                                               */
+/*     In-process stand-in for the InAccel Coral runtime API     */
+/*                                                               */
+/*===============================================================*/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <queue>
+#include <stdexcept>
+#include <thread>
+
+#include <inaccel/coral>
+
+#include "../utils.h"
+#include "haar.h"
+#include "safe_queue.h"
+
+namespace inaccel {
+
+typedef std::chrono::steady_clock::time_point timestamp;
+
+typedef struct {
+	std::string accelerator;
+	std::vector<argument> args;
+	std::promise<void> done;
+	timestamp submitted;
+} job;
+
+// Completed jobs held back until their latency has passed.
+typedef struct {
+	timestamp due;
+	job *completed;
+} delivery;
+
+struct later {
+	bool operator()(const delivery& a, const delivery& b) const { return a.due > b.due; }
+};
+
+class Runtime {
+public:
+	Runtime(void);
+
+	~Runtime(void);
+
+	void submit(job *j);
+
+private:
+	void device(int id);
+
+	void deliver(void);
+
+	void complete(job *j);
+
+	int n_devices;
+	std::chrono::microseconds latency;
+	std::chrono::nanoseconds service_time;	// per request and device, from INACCEL_LOCAL_FPS
+
+	// One queue per device; NULL stops it.
+	std::vector<SafeQueue<job*>*> queues;
+	std::vector<std::atomic<int>*> outstanding;
+	std::vector<std::thread> devices;
+	std::atomic<unsigned> next;
+
+	std::mutex m;
+	std::condition_variable c;
+	std::priority_queue<delivery, std::vector<delivery>, later> pending;
+	bool stopped;
+	std::thread deliverer;
+};
+
+static long environment(const char *name, long fallback) {
+	const char *value = getenv(name);
+	return value ? atol(value) : fallback;
+}
+
+Runtime::Runtime(void): next(0), stopped(false) {
+	n_devices = std::max(1L, environment("INACCEL_LOCAL_DEVICES", 1));
+	latency = std::chrono::microseconds(std::max(0L, environment("INACCEL_LOCAL_LATENCY_US", 0)));
+
+	long fps = environment("INACCEL_LOCAL_FPS", 0);
+	service_time = std::chrono::nanoseconds(fps > 0 ? 1000000000L / fps : 0);
+
+	std::cout << "Local accelerator: " << n_devices << " device(s), latency " << latency.count() << " us, "
+		<< (fps > 0 ? std::to_string(fps) + " requests/s" : std::string("unthrottled")) << " per device\n";
+
+	for (int i = 0; i < n_devices; i++) {
+		queues.push_back(new SafeQueue<job*>());
+		outstanding.push_back(new std::atomic<int>(0));
+	}
+	for (int i = 0; i < n_devices; i++) devices.push_back(std::thread(&Runtime::device, this, i));
+
+	if (latency.count()) deliverer = std::thread(&Runtime::deliver, this);
+}
+
+Runtime::~Runtime(void) {
+	for (int i = 0; i < n_devices; i++) queues[i]->enqueue(NULL);
+	for (int i = 0; i < n_devices; i++) devices[i].join();
+
+	{
+		std::lock_guard<std::mutex> lock(m);
+		stopped = true;
+	}
+	c.notify_all();
+	if (deliverer.joinable()) deliverer.join();
+
+	for (int i = 0; i < n_devices; i++) {
+		delete queues[i];
+		delete outstanding[i];
+	}
+}
+
+void Runtime::submit(job *j) {
+	// The device with the fewest requests queued or running; ties rotate.
+	unsigned start = next++;
+	int best = start % n_devices;
+	for (int k = 1; k < n_devices; k++) {
+		int d = (start + k) % n_devices;
+		if (outstanding[d]->load() < outstanding[best]->load()) best = d;
+	}
+
+	(*outstanding[best])++;
+	queues[best]->enqueue(j);
+}
+
+// Same arguments as the kernel: the 320x240 gray input, then the x, y, width
+// and height of every candidate window and their count. Candidates are the
+// raw cascade hits before grouping, which the host does, and are cut off at
+// the size of the result buffers.
+static void face_detect(myCascade *cascade, int **classifier, const std::vector<argument>& args) {
+	if (args.size() != 6 || !args[0].data || args[0].size < KERNEL_WIDTH * KERNEL_HEIGHT) {
+		throw std::invalid_argument("face-detect: expected input, result_x, result_y, result_w, result_h, res_size");
+	}
+
+	size_t capacity = args[1].size / sizeof(int);
+	for (int i = 2; i <= 5; i++) {
+		if (!args[i].data) throw std::invalid_argument("face-detect: results must be buffers");
+		if (i < 5) capacity = std::min(capacity, args[i].size / sizeof(int));
+	}
+
+	MyImage image = {KERNEL_WIDTH, KERNEL_HEIGHT, 255, (unsigned char *) args[0].data, 1};
+	MySize minSize = {20, 20};
+	MySize maxSize = {0, 0};
+
+	std::vector<MyRect> candidates;
+	detectObjects(&image, KERNEL_WIDTH, minSize, maxSize, cascade, 1.2f, 0,
+		classifier[0], classifier[1], classifier[2], classifier[3], classifier[4], classifier[5], classifier[6],
+		(int **) classifier[7], candidates, NULL, NULL);
+
+	int *x = (int *) args[1].data, *y = (int *) args[2].data, *w = (int *) args[3].data, *h = (int *) args[4].data;
+	int n = std::min(candidates.size(), capacity);
+
+	for (int i = 0; i < n; i++) {
+		x[i] = candidates[i].x;
+		y[i] = candidates[i].y;
+		w[i] = candidates[i].width;
+		h[i] = candidates[i].height;
+	}
+	*(int *) args[5].data = n;
+}
+
+void Runtime::device(int id) {
+	// Every device has its own classifier, as the cascade rescales it per level.
+	myCascade cascade;
+	cascade.n_stages = 25;
+	cascade.total_nodes = 2913;
+	cascade.orig_window_size.height = 24;
+	cascade.orig_window_size.width = 24;
+
+	int *classifier[8];
+	readTextClassifier(&classifier[0], &classifier[1], &classifier[2], &classifier[3], &classifier[4],
+		&classifier[5], &classifier[6], (int ***) &classifier[7]);
+
+	while (true) {
+		job *j = queues[id]->dequeue();
+		if (!j) break;
+
+		timestamp start = std::chrono::steady_clock::now();
+
+		try {
+			if (j->accelerator != "edu.cornell.ece.zhang.rosetta.face-detect") {
+				throw std::invalid_argument("no such accelerator: " + j->accelerator);
+			}
+			face_detect(&cascade, classifier, j->args);
+		}
+		catch (...) {
+			j->done.set_exception(std::current_exception());
+			(*outstanding[id])--;
+			delete j;
+			continue;
+		}
+
+		// A device never finishes requests faster than its configured rate.
+		if (service_time.count()) std::this_thread::sleep_until(start + service_time);
+
+		(*outstanding[id])--;
+		complete(j);
+	}
+
+	releaseTextClassifier(classifier[0], classifier[1], classifier[2], classifier[3], classifier[4],
+		classifier[5], classifier[6], (int **) classifier[7]);
+}
+
+void Runtime::complete(job *j) {
+	timestamp due = j->submitted + latency;
+
+	if (!latency.count() || due <= std::chrono::steady_clock::now()) {
+		j->done.set_value();
+		delete j;
+		return;
+	}
+
+	delivery d;
+	d.due = due;
+	d.completed = j;
+	{
+		std::lock_guard<std::mutex> lock(m);
+		pending.push(d);
+	}
+	c.notify_one();
+}
+
+void Runtime::deliver(void) {
+	std::unique_lock<std::mutex> lock(m);
+
+	while (!stopped || !pending.empty()) {
+		if (pending.empty()) {
+			c.wait(lock);
+			continue;
+		}
+
+		delivery d = pending.top();
+		if (std::chrono::steady_clock::now() < d.due) {
+			c.wait_until(lock, d.due);
+			continue;
+		}
+
+		pending.pop();
+		lock.unlock();
+		d.completed->done.set_value();
+		delete d.completed;
+		lock.lock();
+	}
+}
+
+std::future<void> submit(request& request) {
+	static Runtime runtime;
+
+	job *j = new job;
+	j->accelerator = request.accelerator;
+	j->args = request.args;
+	j->submitted = std::chrono::steady_clock::now();
+
+	std::future<void> response = j->done.get_future();
+	runtime.submit(j);
+	return response;
+}
+
+}
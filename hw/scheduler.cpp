@@ -0,0 +1,226 @@
+/*===============================================================*/
+/*                                                               */
+/*                         scheduler.cpp                         */
+/*                                                               */
+/*         Accelerator or CPU, decided for every frame           */
+/*                                                               */
+/*===============================================================*/
+
+#include <algorithm>
+#include <cstdlib>
+#include <future>
+#include <iostream>
+#include <stdexcept>
+
+#include "scheduler.h"
+#include "trace.h"
+#include "utils.h"
+
+Scheduler::Scheduler(int stream, int depth, cv::Size size, CpuDetector *cpu, std::chrono::steady_clock::duration latency_target,
+	std::chrono::steady_clock::duration spill_latency):
+	stream(stream), size(size), kernel_size(size == cv::Size(KERNEL_WIDTH, KERNEL_HEIGHT)),
+	inflight(depth, latency_target), cpu(cpu),
+	spill_ns(std::chrono::duration_cast<std::chrono::nanoseconds>(spill_latency).count()), failed(false),
+	n_accelerator(0), n_spilled_latency(0), n_spilled_depth(0), n_failed_over(0), n_other_size(0), n_redone(0) {
+	if (!kernel_size && !cpu) throw std::invalid_argument("accelerator: no CPU workers for frames of another size than the kernel's");
+	inflight.monitor("inflight " + std::to_string(stream));
+}
+
+void Scheduler::attach(detect_job *job) {
+	buffer_set *buffers = new buffer_set;
+	buffers->input.resize(size.area());
+	buffers->result_x.resize(RESULT_SIZE);
+	buffers->result_y.resize(RESULT_SIZE);
+	buffers->result_w.resize(RESULT_SIZE);
+	buffers->result_h.resize(RESULT_SIZE);
+	buffers->res_size.resize(1);
+
+	// The preprocessor writes straight into the accelerator's input buffer.
+	job->input = cv::Mat(size, CV_8UC1, buffers->input.data());
+	job->context = buffers;
+}
+
+void Scheduler::detach(detect_job *job) {
+	job->input.release();
+	delete (buffer_set *) job->context;
+	job->context = NULL;
+}
+
+void Scheduler::submit(detect_job *job) {
+	long frame = job->frame;
+
+	if (!kernel_size) {
+		job->on_cpu = true;
+		job->submitted = std::chrono::steady_clock::now();
+		job->response = cpu->submit(job);
+		n_other_size++;
+		return;
+	}
+
+	if (cpu && failed) {
+		job->on_cpu = true;
+		job->submitted = std::chrono::steady_clock::now();
+		job->response = cpu->submit(job);
+		n_failed_over++;
+		return;
+	}
+
+	if (cpu && spill_ns && inflight.latency() > std::chrono::nanoseconds(spill_ns)) {
+		job->submitted = std::chrono::steady_clock::now();
+		job->response = cpu->try_submit(job);
+		if (job->response.valid()) {
+			job->on_cpu = true;
+			n_spilled_latency++;
+			return;
+		}
+	}
+
+	if (!inflight.try_acquire()) {
+		if (cpu) {
+			job->submitted = std::chrono::steady_clock::now();
+			job->response = cpu->try_submit(job);
+			if (job->response.valid()) {
+				job->on_cpu = true;
+				n_spilled_depth++;
+				return;
+			}
+		}
+
+		TraceScope trace("depth wait", stream, frame);
+		inflight.acquire();
+	}
+
+	buffer_set *buffers = (buffer_set *) job->context;
+	job->on_cpu = false;
+	job->submitted = std::chrono::steady_clock::now();
+
+	try {
+		TraceScope trace("submit", stream, frame);
+
+		inaccel::request facedetect("edu.cornell.ece.zhang.rosetta.face-detect");
+		facedetect.arg(buffers->input).arg(buffers->result_x).arg(buffers->result_y)
+			.arg(buffers->result_w).arg(buffers->result_h).arg(buffers->res_size);
+
+		job->response = inaccel::submit(facedetect);
+	}
+	catch (std::exception &e) {
+		if (!cpu) {
+			// The frame fails when it completes, which gives its slot back
+			// and ends the stream.
+			std::promise<void> failure;
+			failure.set_exception(std::current_exception());
+			job->response = failure.get_future();
+			return;
+		}
+
+		inflight.cancel();
+		std::cerr << "Stream " << stream << ": accelerator unavailable (" << e.what() << "), continuing on the CPU" << std::endl;
+		failed = true;
+
+		job->on_cpu = true;
+		job->response = cpu->submit(job);
+		n_failed_over++;
+		return;
+	}
+
+	n_accelerator++;
+}
+
+bool Scheduler::complete(detect_job *job) {
+	if (job->on_cpu) {
+		job->response.get();
+		return true;
+	}
+
+	try {
+		job->response.get();
+	}
+	catch (std::exception &e) {
+		inflight.cancel();
+		if (!cpu) throw;
+
+		if (!failed.exchange(true)) {
+			std::cerr << "Stream " << stream << ": accelerator failed (" << e.what() << "), continuing on the CPU" << std::endl;
+		}
+
+		// The buffers are untouched or partly written; run the frame again,
+		// and let the dispatcher collect it with the others.
+		job->on_cpu = true;
+		job->submitted = std::chrono::steady_clock::now();
+		job->completed = timestamp();
+		job->response = cpu->submit(job);
+		n_redone++;
+		return false;
+	}
+
+	// Not when the dispatcher got round to it, which depends on its other work.
+	inflight.complete(job->completed - job->submitted);
+
+	// The kernel's results are in structure-of-arrays form.
+	buffer_set *buffers = (buffer_set *) job->context;
+	int n = std::min(buffers->res_size[0], RESULT_SIZE);
+
+	job->candidates.resize(n);
+	for (int i = 0; i < n; i++) {
+		job->candidates[i].x = buffers->result_x[i];
+		job->candidates[i].y = buffers->result_y[i];
+		job->candidates[i].width = buffers->result_w[i];
+		job->candidates[i].height = buffers->result_h[i];
+	}
+	return true;
+}
+
+void Scheduler::print(const std::string& name) {
+	if (kernel_size) inflight.print(name);
+
+	if (!cpu) return;
+
+	if (!kernel_size) {
+		std::cout << "[" << name << "] CPU: " << n_other_size << " frames (all, the kernel does not take "
+			<< size.width << "x" << size.height << ")" << std::endl;
+		return;
+	}
+
+	std::cout << "[" << name << "] accelerator: " << n_accelerator << " frames, CPU: "
+		<< n_spilled_latency + n_spilled_depth + n_failed_over + n_redone << " frames ("
+		<< n_spilled_latency << " over the spill latency, " << n_spilled_depth << " over the in-flight limit, "
+		<< n_failed_over + n_redone << " after an accelerator failure)" << std::endl;
+}
+
+void Scheduler::finish(BenchStats *bench) {
+	// The cascade work of the frames that ran on the CPU.
+	if (cpu) {
+		cascade_work work = cpu->take_work(stream);
+		if (bench) bench->set_cascade(work);
+	}
+}
+
+AcceleratorBackend::AcceleratorBackend(const app_options& options):
+	latency_target(std::chrono::microseconds((long long) (options.latency_target * 1000))),
+	spill_latency(std::chrono::microseconds((long long) (options.spill_latency * 1000))) {
+	// Shared by all streams; frames only go there when the accelerator
+	// cannot take them.
+	cpu = options.cpu_workers ? new CpuDetector(options.cpu_workers) : NULL;
+
+	for (unsigned i = 0; i < std::max(options.inputs.size(), options.detect_sizes.size()) && !cpu; i++) {
+		frame_size size = detect_size(options, i);
+		if (size.width != KERNEL_WIDTH || size.height != KERNEL_HEIGHT) {
+			std::cerr << "The accelerator only detects at " << KERNEL_WIDTH << "x" << KERNEL_HEIGHT
+				<< "; --detect-size " << size.width << "x" << size.height << " needs --cpu-workers" << std::endl;
+			exit(-1);
+		}
+	}
+}
+
+AcceleratorBackend::~AcceleratorBackend(void) {
+	delete cpu;
+}
+
+int AcceleratorBackend::depth(const app_options& options, int streams) const {
+	if (options.max_inflight) return options.max_inflight;
+	return (options.live && options.policy == DROP_STALE) ? 4 : 64;
+}
+
+StreamDetector *AcceleratorBackend::open(int stream, int depth, cv::Size size) {
+	return new Scheduler(stream, depth, size, cpu, latency_target, spill_latency);
+}
@@ -0,0 +1,113 @@
+#ifndef SCHEDULER
+#define SCHEDULER
+
+/*===============================================================*/
+/*                                                               */
+/*                          scheduler.h                          */
+/*                                                               */
+/*         Accelerator or CPU, decided for every frame           */
+/*                                                               */
+/*===============================================================*/
+
+#include <atomic>
+#include <chrono>
+#include <string>
+
+// InAccel API
+#include <inaccel/coral>
+
+#include "cpu_detector.h"
+#include "detector.h"
+#include "inflight.h"
+
+// Everything one face-detect request reads and writes on the accelerator,
+// allocated once per job.
+typedef struct {
+	inaccel::vector<unsigned char> input;
+	inaccel::vector<int> result_x;
+	inaccel::vector<int> result_y;
+	inaccel::vector<int> result_w;
+	inaccel::vector<int> result_h;
+	inaccel::vector<int> res_size;
+} buffer_set;
+
+// Sends the frames of one stream to the accelerator and, given CPU workers,
+// spills a frame to them instead when
+//   - the accelerator's latency (see InflightController::latency) is over
+//     `spill_latency` (if set), or
+//   - the stream has as many requests in flight as its controller allows,
+// provided a worker is free at that moment; otherwise the frame waits for the
+// accelerator as usual. Once a request fails, or cannot be submitted, the
+// whole stream moves to the CPU and the failed frame is run again there.
+// Without CPU workers every frame waits for the accelerator, and a failed
+// request ends the stream. A stream detected
+// at another size than the kernel's (see utils.h) runs on the CPU throughout.
+class Scheduler: public StreamDetector {
+public:
+	// `cpu` may be NULL and is shared by all streams; it must be given for
+	// sizes the kernel does not take. The stream's in-flight controller (see
+	// inflight.h) allows at most `depth` requests.
+	Scheduler(int stream, int depth, cv::Size size, CpuDetector *cpu, std::chrono::steady_clock::duration latency_target,
+		std::chrono::steady_clock::duration spill_latency);
+
+	void attach(detect_job *job);
+
+	void detach(detect_job *job);
+
+	void submit(detect_job *job);
+
+	bool complete(detect_job *job);
+
+	// The in-flight limit and where the frames went.
+	void print(const std::string& name);
+
+	void finish(BenchStats *bench);
+
+private:
+	int stream;
+	cv::Size size;
+	bool kernel_size;	// frames can go to the accelerator at all
+	InflightController inflight;
+	CpuDetector *cpu;
+	long long spill_ns;
+
+	std::atomic<bool> failed;
+
+	// Written by the submitter.
+	unsigned long n_accelerator;
+	unsigned long n_spilled_latency;
+	unsigned long n_spilled_depth;
+	unsigned long n_failed_over;
+	unsigned long n_other_size;
+
+	// Written by the dispatcher.
+	unsigned long n_redone;
+};
+
+// Every frame on the accelerator, overflowing to --cpu-workers (the hw
+// target).
+class AcceleratorBackend: public DetectorBackend {
+public:
+	// Exits if a --detect-size other than the kernel's has no CPU workers
+	// to run on. Throws std::runtime_error if the CPU workers' classifier
+	// cannot be read.
+	AcceleratorBackend(const app_options& options);
+
+	~AcceleratorBackend(void);
+
+	const char *name(void) const { return "FPGA"; }
+
+	// Only a few requests when latency matters more than throughput;
+	// within that bound each stream's controller finds the depth that
+	// keeps the accelerator busy.
+	int depth(const app_options& options, int streams) const;
+
+	StreamDetector *open(int stream, int depth, cv::Size size);
+
+private:
+	CpuDetector *cpu;	// NULL without --cpu-workers
+	std::chrono::steady_clock::duration latency_target;
+	std::chrono::steady_clock::duration spill_latency;
+};
+
+#endif
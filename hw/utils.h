@@ -9,14 +9,11 @@
 /*                                                               */
 /*===============================================================*/
 
-const int IMAGE_HEIGHT = 240;
-const int IMAGE_WIDTH = 320;
-const int RESULT_SIZE = 100;
-
-void print_usage(char* filename);
+// The only input size the face-detect kernel is built for.
+const int KERNEL_WIDTH = 320;
+const int KERNEL_HEIGHT = 240;
 
-void parse_command_line_args(int argc, char** argv, std::string& outFile);
-
-void drawRectangles(int result_size, int *result_x, int *result_y, int *result_w, int *result_h, unsigned char *frame);
+// Most candidates the face-detect kernel reports for one frame.
+const int RESULT_SIZE = 100;
 
 #endif
@@ -0,0 +1,208 @@
+/*===============================================================*/
+/*                                                               */
+/*                        cpu_detector.cpp                       */
+/*                                                               */
+/*           The software cascade as a detection backend         */
+/*                                                               */
+/*===============================================================*/
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+#include "cpu_detector.h"
+#include "haar.h"
+#include "trace.h"
+
+// Add what one detectObjects call did, the difference of the calling
+// thread's counters around it, to a stream's totals.
+static void add_work(cascade_work& total, const MyCascadeStats& before, const MyCascadeStats& after) {
+	if (total.level_windows.empty()) {
+		total.frames = total.windows = total.accepted = total.features = 0;
+		total.candidates = total.candidates_max = 0;
+		total.level_windows.assign(STATS_LEVELS, 0);
+		total.stage_rejections.assign(STATS_STAGES, 0);
+	}
+
+	total.frames += after.frames - before.frames;
+	total.windows += after.windows - before.windows;
+	total.accepted += after.accepted - before.accepted;
+	total.features += after.features - before.features;
+	total.candidates += after.candidates - before.candidates;
+	total.candidates_max = std::max(total.candidates_max, after.candidates - before.candidates);
+
+	for (int i = 0; i < STATS_LEVELS; i++) total.level_windows[i] += after.level_windows[i] - before.level_windows[i];
+	for (int i = 0; i < STATS_STAGES; i++) total.stage_rejections[i] += after.stage_rejections[i] - before.stage_rejections[i];
+}
+
+CpuDetector::CpuDetector(int workers): idle(0), stopped(false) {
+	if (loadTextClassifier("sw/info.txt", "sw/class.txt", &n_stages, &total_nodes, &stages_array, &rectangles_array,
+		&weights_array, &alpha1_array, &alpha2_array, &tree_thresh_array, &stages_thresh_array) != 0) {
+		throw std::runtime_error("cannot read the classifier in sw/info.txt and sw/class.txt");
+	}
+
+	for (int i = 0; i < workers; i++) threads.push_back(std::thread(&CpuDetector::worker, this, i));
+}
+
+CpuDetector::~CpuDetector(void) {
+	{
+		std::lock_guard<std::mutex> lock(m);
+		stopped = true;
+	}
+	c.notify_all();
+
+	for (unsigned i = 0; i < threads.size(); i++) threads[i].join();
+
+	releaseTextClassifier(stages_array, rectangles_array, weights_array, alpha1_array, alpha2_array,
+		tree_thresh_array, stages_thresh_array, NULL);
+}
+
+std::future<void> CpuDetector::queue(detect_job *job) {
+	work_item *item = new work_item;
+	item->job = job;
+
+	std::future<void> response = item->done.get_future();
+	items.push_back(item);
+	c.notify_one();
+	return response;
+}
+
+std::future<void> CpuDetector::submit(detect_job *job) {
+	std::lock_guard<std::mutex> lock(m);
+	return queue(job);
+}
+
+std::future<void> CpuDetector::try_submit(detect_job *job) {
+	std::lock_guard<std::mutex> lock(m);
+	if ((int) items.size() >= idle) return std::future<void>();
+	return queue(job);
+}
+
+cascade_work CpuDetector::take_work(int stream) {
+	std::lock_guard<std::mutex> lock(m);
+
+	cascade_work total = cascade_work();
+	std::map<int, cascade_work>::iterator it = work.find(stream);
+	if (it != work.end()) {
+		total = it->second;
+		work.erase(it);
+	}
+	return total;
+}
+
+void CpuDetector::worker(int id) {
+	trace_thread("cpu worker " + std::to_string(id));
+
+	// Every worker has its own cascade and scaled rectangles, as the cascade
+	// rescales the shared classifier to each level it scans.
+	myCascade cascade;
+	cascade.n_stages = n_stages;
+	cascade.total_nodes = total_nodes;
+	cascade.orig_window_size.height = 24;
+	cascade.orig_window_size.width = 24;
+
+	std::vector<int *> scaled_rectangles_array(total_nodes * 12);
+
+	MySize minSize = {20, 20};
+	MySize maxSize = {0, 0};
+
+	std::unique_lock<std::mutex> lock(m);
+
+	while (true) {
+		idle++;
+		while (items.empty() && !stopped) c.wait(lock);
+		idle--;
+
+		if (items.empty()) break;
+
+		work_item *item = items.front();
+		items.pop_front();
+		lock.unlock();
+
+		detect_job *job = item->job;
+		MyCascadeStats before, after;
+		getThreadCascadeStats(&before);
+
+		{
+			TraceScope trace("cpu detect", job->stream, job->frame);
+
+			MyImage image = {job->input.cols, job->input.rows, 255, job->input.data, 1};
+
+			// No grouping here: the pipeline groups every backend's candidates.
+			MyTiming timing;
+			// Into the job's own vector, which keeps its storage in the pool.
+			detectObjects(&image, (int) job->input.step, minSize, maxSize, &cascade, 1.2f, 0,
+				stages_array, rectangles_array, weights_array, alpha1_array, alpha2_array,
+				tree_thresh_array, stages_thresh_array, scaled_rectangles_array.data(), job->candidates, NULL, &timing);
+
+			job->pyramid_ns = timing.pyramid;
+			job->cascade_ns = timing.cascade;
+		}
+
+		getThreadCascadeStats(&after);
+
+		// Counted before the job is done, so the stream's totals are
+		// complete once its last response is.
+		lock.lock();
+		add_work(work[job->stream], before, after);
+
+		item->done.set_value();
+		delete item;
+	}
+
+	lock.unlock();
+}
+
+// A stream whose frames all go to the shared workers.
+class CpuStream: public StreamDetector {
+public:
+	CpuStream(int stream, cv::Size size, CpuDetector *cpu): stream(stream), size(size), cpu(cpu) {}
+
+	void attach(detect_job *job) {
+		job->input.create(size, CV_8UC1);
+	}
+
+	void detach(detect_job *job) {
+		job->input.release();
+	}
+
+	// The workers read the input where it lies.
+	bool borrows_input(void) const { return true; }
+
+	void submit(detect_job *job) {
+		job->on_cpu = true;
+		job->submitted = std::chrono::steady_clock::now();
+
+		TraceScope trace("submit", stream, job->frame);
+		job->response = cpu->submit(job);
+	}
+
+	bool complete(detect_job *job) {
+		job->response.get();
+		return true;
+	}
+
+	void finish(BenchStats *bench) {
+		cascade_work work = cpu->take_work(stream);
+		if (bench) bench->set_cascade(work);
+	}
+
+private:
+	int stream;
+	cv::Size size;
+	CpuDetector *cpu;
+};
+
+CpuBackend::CpuBackend(int workers): cpu(workers) {
+}
+
+int CpuBackend::depth(const app_options& options, int streams) const {
+	if (options.max_inflight) return options.max_inflight;
+
+	int share = (cpu.workers() + streams - 1) / std::max(streams, 1);
+	return std::min(std::max(share, 1) + 1, 64);
+}
+
+StreamDetector *CpuBackend::open(int stream, int depth, cv::Size size) {
+	return new CpuStream(stream, size, &cpu);
+}
@@ -0,0 +1,95 @@
+#ifndef CPU_DETECTOR
+#define CPU_DETECTOR
+
+/*===============================================================*/
+/*                                                               */
+/*                         cpu_detector.h                        */
+/*                                                               */
+/*           The software cascade as a detection backend         */
+/*                                                               */
+/*===============================================================*/
+
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "bench.h"
+#include "detector.h"
+
+// Worker threads that run the CPU cascade on the jobs of any stream. A job
+// comes out exactly as from the face-detect kernel: the raw candidates
+// before grouping, which the pipeline groups and draws the same way.
+class CpuDetector {
+public:
+	// Loads the classifier from sw/info.txt and sw/class.txt once, for all
+	// workers to read; throws std::runtime_error if it cannot be read.
+	CpuDetector(int workers);
+
+	~CpuDetector(void);
+
+	int workers(void) const { return threads.size(); }
+
+	// Queue a job; the returned future is ready once its candidates are.
+	std::future<void> submit(detect_job *job);
+
+	// Queue a job only if a worker is free to start on it at once;
+	// otherwise the returned future is invalid.
+	std::future<void> try_submit(detect_job *job);
+
+	// The cascade work done for `stream` so far, which is then forgotten.
+	cascade_work take_work(int stream);
+
+private:
+	typedef struct {
+		detect_job *job;
+		std::promise<void> done;
+	} work_item;
+
+	std::future<void> queue(detect_job *job);
+
+	void worker(int id);
+
+	std::mutex m;
+	std::condition_variable c;
+	std::deque<work_item*> items;
+	int idle;		// workers waiting for a job
+	bool stopped;
+	std::map<int, cascade_work> work;
+
+	// The classifier, only read once loaded.
+	int n_stages;
+	int total_nodes;
+	int *stages_array;
+	int *rectangles_array;
+	int *weights_array;
+	int *alpha1_array;
+	int *alpha2_array;
+	int *tree_thresh_array;
+	int *stages_thresh_array;
+
+	std::vector<std::thread> threads;
+};
+
+// Every frame on the CPU workers (the sw target).
+class CpuBackend: public DetectorBackend {
+public:
+	// Throws std::runtime_error if the classifier cannot be read.
+	CpuBackend(int workers);
+
+	const char *name(void) const { return "CPU"; }
+
+	// Enough frames per stream to keep its share of the workers busy while
+	// the next one is preprocessed.
+	int depth(const app_options& options, int streams) const;
+
+	StreamDetector *open(int stream, int depth, cv::Size size);
+
+private:
+	CpuDetector cpu;
+};
+
+#endif
@@ -0,0 +1,79 @@
+/*===============================================================*/
+/*                                                               */
+/*                         facedetect.cpp                        */
+/*                                                               */
+/*          The CPU cascade as an embeddable library             */
+/*                                                               */
+/*===============================================================*/
+
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+#include "facedetect.h"
+#include "haar.h"
+
+Detector::Detector(const std::string& model_dir, int min_size, float scale_factor, int min_neighbors):
+	min_size(min_size), scale_factor(scale_factor), min_neighbors(min_neighbors) {
+	if (scale_factor <= 1 || min_neighbors < 0) throw std::invalid_argument("facedetect: invalid detector parameters");
+
+	std::string info = model_dir + "/info.txt";
+	std::string classifier = model_dir + "/class.txt";
+
+	if (loadTextClassifier(info.c_str(), classifier.c_str(), &n_stages, &total_nodes, &stages_array, &rectangles_array,
+		&weights_array, &alpha1_array, &alpha2_array, &tree_thresh_array, &stages_thresh_array) != 0) {
+		throw std::runtime_error("facedetect: cannot read the classifier in " + model_dir);
+	}
+}
+
+Detector::~Detector(void) {
+	releaseTextClassifier(stages_array, rectangles_array, weights_array, alpha1_array, alpha2_array,
+		tree_thresh_array, stages_thresh_array, NULL);
+}
+
+// What one thread reuses from call to call: the cascade pointed at the levels
+// it scans, the classifier scaled to them and the windows it finds. They only
+// grow, to the largest model and result seen, as the pyramid buffers in
+// detectObjects do.
+typedef struct {
+	myCascade cascade;
+	std::vector<int *> scaled_rectangles_array;
+	std::vector<MyRect> found;
+} DetectScratch;
+
+int Detector::detect(const unsigned char *data, int width, int height, int stride, face_rect *faces, int capacity) const {
+	if (!data || width <= 0 || height <= 0 || stride < width || capacity < 0 || (capacity && !faces)) return -1;
+	// The integral image of the first level is int, so its last sum must fit.
+	if ((long long) width * height > FACEDETECT_MAX_PIXELS) return -1;
+
+	static thread_local DetectScratch scratch;
+
+	myCascade& cascade = scratch.cascade;
+	cascade.n_stages = n_stages;
+	cascade.total_nodes = total_nodes;
+	cascade.orig_window_size.height = 24;
+	cascade.orig_window_size.width = 24;
+
+	if (scratch.scaled_rectangles_array.size() < (size_t) total_nodes * 12) {
+		scratch.scaled_rectangles_array.resize(total_nodes * 12);
+	}
+
+	// Only read, as the first pyramid level is built from it.
+	MyImage image = {width, height, 255, (unsigned char *) data, 0};
+	MySize minSize = {min_size, min_size};
+	MySize maxSize = {0, 0};
+
+	std::vector<MyRect>& found = scratch.found;
+	detectObjects(&image, stride, minSize, maxSize, &cascade, scale_factor, min_neighbors,
+		stages_array, rectangles_array, weights_array, alpha1_array, alpha2_array, tree_thresh_array,
+		stages_thresh_array, scratch.scaled_rectangles_array.data(), found, NULL, NULL);
+
+	int n = std::min((int) found.size(), capacity);
+	for (int i = 0; i < n; i++) {
+		faces[i].x = found[i].x;
+		faces[i].y = found[i].y;
+		faces[i].width = found[i].width;
+		faces[i].height = found[i].height;
+	}
+	return found.size();
+}
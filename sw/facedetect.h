@@ -0,0 +1,71 @@
+#ifndef FACEDETECT
+#define FACEDETECT
+
+/*===============================================================*/
+/*                                                               */
+/*                          facedetect.h                         */
+/*                                                               */
+/*          The CPU cascade as an embeddable library             */
+/*                                                               */
+/*===============================================================*/
+
+#include <climits>
+#include <string>
+
+// The largest image, in pixels, that Detector::detect accepts: its integral
+// image is int, and must hold the sum of every pixel at 255. About 8.4 MP,
+// e.g. 3840x2160 fits but not 4096x2160.
+#define FACEDETECT_MAX_PIXELS (INT_MAX / 255)
+
+// A face, in pixels of the image given to Detector::detect.
+typedef struct {
+	int x;
+	int y;
+	int width;
+	int height;
+} face_rect;
+
+// The Viola-Jones detector of sw/ for use inside another process, built as
+// libfacedetect.a and libfacedetect.so by `make lib`. A Detector holds only
+// its model, which is read once and never written afterwards, so a single
+// instance can serve any number of threads calling detect() at the same time.
+// Each thread keeps its image pyramid and the classifier scaled to it for
+// itself, and reuses them on its next call: they are allocated again only
+// when a larger image or model needs more room.
+class Detector {
+public:
+	// Reads info.txt and class.txt from `model_dir`. Windows smaller than
+	// `min_size` pixels are not scanned, every pyramid level is `scale_factor`
+	// times smaller than the previous one, and a face needs `min_neighbors`
+	// overlapping windows (0 returns every window, ungrouped). Throws
+	// std::runtime_error if the model cannot be read.
+	Detector(const std::string& model_dir = "sw", int min_size = 20, float scale_factor = 1.2f, int min_neighbors = 1);
+
+	~Detector(void);
+
+	Detector(const Detector&) = delete;
+	Detector& operator=(const Detector&) = delete;
+
+	// Finds the faces in an 8-bit gray image of any size, which is read in
+	// place: row y starts at data + y * stride. Writes up to `capacity` faces
+	// and returns how many were found, which can be more. Returns -1 for an
+	// invalid image or one larger than FACEDETECT_MAX_PIXELS.
+	int detect(const unsigned char *data, int width, int height, int stride, face_rect *faces, int capacity) const;
+
+private:
+	int min_size;
+	float scale_factor;
+	int min_neighbors;
+
+	int n_stages;
+	int total_nodes;
+	int *stages_array;
+	int *rectangles_array;
+	int *weights_array;
+	int *alpha1_array;
+	int *alpha2_array;
+	int *tree_thresh_array;
+	int *stages_thresh_array;
+};
+
+#endif
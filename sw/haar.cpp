@@ -31,8 +31,15 @@
  * what you give them.   Happy coding!
  */
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <mutex>
+
 #include "haar.h"
 #include "image.h"
+#include "perf_counters.h"
 #include "stdio-wrapper.h"
 
 /* TODO: use matrices */
@@ -45,20 +52,114 @@
  ***********************************/
 
 
-int clock_counter = 0;
-float n_features = 0;
+/**************************************************
+ * Cascade statistics.
+ * Every thread counts into its own block, so the
+ * scan never shares a cache line with another
+ * stream. Blocks are registered while their
+ * thread lives; when it exits, its counts move
+ * to a shared total and the block is freed, so
+ * totals can still be read once the streams are
+ * joined and short-lived threads cost nothing.
+ * A block has one writer; readers on other
+ * threads load the counters relaxed, which is
+ * all a report needs.
+ *************************************************/
+typedef struct
+{
+  std::atomic<unsigned long long> frames;
+  std::atomic<unsigned long long> level_windows[STATS_LEVELS];
+  std::atomic<unsigned long long> stage_rejections[STATS_STAGES];
+  std::atomic<unsigned long long> accepted;
+  std::atomic<unsigned long long> features;
+  std::atomic<unsigned long long> candidates;
+  std::atomic<unsigned long long> candidates_max;
+} CascadeCounters;
+
+static std::mutex stats_lock;
+static std::vector<CascadeCounters*> stats_registry;
+/* counts of the threads that have exited */
+static MyCascadeStats stats_retired;
+
+static void addCounters( const CascadeCounters *counters, MyCascadeStats *stats );
+
+/* owns the calling thread's block and retires it when the thread exits */
+class ThreadCounters
+{
+public:
+  ThreadCounters( void ): counters(NULL) {}
+
+  ~ThreadCounters( void )
+  {
+    if( counters == NULL )
+      return;
+
+    std::lock_guard<std::mutex> lock(stats_lock);
+    addCounters(counters, &stats_retired);
+    stats_registry.erase(std::find(stats_registry.begin(), stats_registry.end(), counters));
+    delete counters;
+  }
+
+  CascadeCounters *get( void )
+  {
+    if( counters == NULL )
+      {
+	counters = new CascadeCounters();
+	std::lock_guard<std::mutex> lock(stats_lock);
+	stats_registry.push_back(counters);
+      }
+    return counters;
+  }
 
+private:
+  CascadeCounters *counters;
+};
 
-int iter_counter = 0;
+static CascadeCounters *threadCounters( void )
+{
+  static thread_local ThreadCounters counters;
+  return counters.get();
+}
+
+/* only the owning thread writes, so no locked read-modify-write is needed */
+static inline void count( std::atomic<unsigned long long> &counter, unsigned long long n )
+{
+  counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
 
-/* compute integral images */
-void integralImages( MyImage *src, MyIntImage *sum, MyIntImage *sqsum );
+static void addCounters( const CascadeCounters *counters, MyCascadeStats *stats )
+{
+  int i;
 
-/* scale down the image */
-void ScaleImage_Invoker( myCascade* _cascade, float _factor, int sum_row, int sum_col, std::vector<MyRect>& _vec, int *stages_array, int *stages_thresh_array, int *weights_array, int *alpha1_array, int *alpha2_array, int *tree_thresh_array, int **scaled_rectangles_array);
+  stats->frames += counters->frames.load(std::memory_order_relaxed);
+  for( i = 0; i < STATS_LEVELS; i++ )
+    {
+      stats->level_windows[i] += counters->level_windows[i].load(std::memory_order_relaxed);
+      stats->windows += counters->level_windows[i].load(std::memory_order_relaxed);
+    }
+  for( i = 0; i < STATS_STAGES; i++ )
+    stats->stage_rejections[i] += counters->stage_rejections[i].load(std::memory_order_relaxed);
+  stats->accepted += counters->accepted.load(std::memory_order_relaxed);
+  stats->features += counters->features.load(std::memory_order_relaxed);
+  stats->candidates += counters->candidates.load(std::memory_order_relaxed);
+  stats->candidates_max = std::max(stats->candidates_max, counters->candidates_max.load(std::memory_order_relaxed));
+}
 
-/* compute scaled image */
-void nearestNeighbor (MyImage *src, MyImage *dst);
+void getThreadCascadeStats( MyCascadeStats *stats )
+{
+  memset(stats, 0, sizeof(*stats));
+  addCounters(threadCounters(), stats);
+}
+
+void getCascadeStats( MyCascadeStats *stats )
+{
+  memset(stats, 0, sizeof(*stats));
+
+  std::lock_guard<std::mutex> lock(stats_lock);
+  *stats = stats_retired;
+  for( unsigned t = 0; t < stats_registry.size(); t++ )
+    addCounters(stats_registry[t], stats);
+}
 
 /* rounding function */
 inline  int  myRound( float value )
@@ -66,16 +167,86 @@ inline  int  myRound( float value )
   return (int)(value + (value >= 0 ? 0.5 : -0.5));
 }
 
+/* nanoseconds elapsed since *since, which is then moved to now */
+static long long lap( std::chrono::steady_clock::time_point *since )
+{
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  long long ns = std::chrono::duration_cast<std::chrono::nanoseconds>(now - *since).count();
+  *since = now;
+  return ns;
+}
+
+/***********************************************************
+ * nearestNeighbor on a source whose rows start step bytes
+ * apart, e.g. a region of a larger frame
+ **********************************************************/
+static void downsample (const unsigned char *src_data, int w1, int h1, int step, MyImage *dst)
+{
+
+  int y;
+  int j;
+  int x;
+  int i;
+  unsigned char* t;
+  const unsigned char* p;
+  int w2 = dst->width;
+  int h2 = dst->height;
+
+  int rat = 0;
+
+  unsigned char* dst_data = dst->data;
+
+
+  int x_ratio = (int)((w1<<16)/w2) +1;
+  int y_ratio = (int)((h1<<16)/h2) +1;
+
+  for (i=0;i<h2;i++)
+    {
+      t = dst_data + i*w2;
+      y = ((i*y_ratio)>>16);
+      p = src_data + y*step;
+      rat = 0;
+      for (j=0;j<w2;j++)
+	{
+	  x = (rat>>16);
+	  *t++ = p[x];
+	  rat += x_ratio;
+	}
+    }
+}
+
 /*******************************************************
  * Function: detectObjects
  * Description: It calls all the major steps
  ******************************************************/
 
-std::vector<MyRect> detectObjects( MyImage* _img, MySize minSize, MySize maxSize,
-					myCascade* cascade, float scaleFactor, int minNeighbors,
-					int *stages_array, int *rectangles_array, int *weights_array,
-					int *alpha1_array, int *alpha2_array, int *tree_thresh_array,
-					int *stages_thresh_array, int **scaled_rectangles_array)
+/**************************************************
+ * Pyramid buffers of one thread. They are kept
+ * between detectObjects calls and only grow, so
+ * a thread that scans frames of the same size
+ * allocates nothing after the first one.
+ *************************************************/
+typedef struct
+{
+  std::vector<unsigned char> img;
+  std::vector<sumtype> sum;
+  std::vector<sqsumtype> sqsum;
+} PyramidScratch;
+
+template <typename T>
+static T *reserveScratch( std::vector<T> &buffer, size_t n )
+{
+  if( buffer.size() < n )
+    buffer.resize(n);
+  return buffer.data();
+}
+
+void detectObjects( MyImage* _img, int step, MySize minSize, MySize maxSize,
+		    myCascade* cascade, float scaleFactor, int minNeighbors,
+		    int *stages_array, int *rectangles_array, int *weights_array,
+		    int *alpha1_array, int *alpha2_array, int *tree_thresh_array,
+		    int *stages_thresh_array, int **scaled_rectangles_array,
+		    std::vector<MyRect>& candidates, int *n_candidates, MyTiming *timing)
 {
 
   /* group overlaping windows */
@@ -87,15 +258,15 @@ std::vector<MyRect> detectObjects( MyImage* _img, MySize minSize, MySize maxSize
    * see haar.h for details
    * img1: normal image (unsigned char)
    * sum1: integral image (int)
-   * sqsum1: square integral image (int)
+   * sqsum1: square integral image (long long)
    **********************************/
   MyImage image1Obj;
   MyIntImage sum1Obj;
-  MyIntImage sqsum1Obj;
+  MySqSumImage sqsum1Obj;
   /* pointers for the created structs */
   MyImage *img1 = &image1Obj;
   MyIntImage *sum1 = &sum1Obj;
-  MyIntImage *sqsum1 = &sqsum1Obj;
+  MySqSumImage *sqsum1 = &sqsum1Obj;
 
   /********************************************************
    * allCandidates is the preliminaray face candidate,
@@ -108,7 +279,8 @@ std::vector<MyRect> detectObjects( MyImage* _img, MySize minSize, MySize maxSize
    * MyRect struct keeps the info of a rectangle (see haar.h)
    * The rectangle contains one face candidate
    *****************************************************/
-  std::vector<MyRect> allCandidates;
+  std::vector<MyRect> &allCandidates = candidates;
+  allCandidates.clear();
 
   /* scaling factor */
   float factor;
@@ -123,12 +295,32 @@ std::vector<MyRect> detectObjects( MyImage* _img, MySize minSize, MySize maxSize
   /* window size of the training set */
   MySize winSize0 = cascade->orig_window_size;
 
-  /* malloc for img1: unsigned char */
-  createImage(img->width, img->height, img1);
-  /* malloc for sum1: unsigned char */
-  createSumImage(img->width, img->height, sum1);
-  /* malloc for sqsum1: unsigned char */
-  createSumImage(img->width, img->height, sqsum1);
+  /* buffers for img1, sum1 and sqsum1 from the thread's scratch */
+  /* (windows on the last row reach one row past the integral images, */
+  /* so they get a zeroed row more than the image instead of reading */
+  /* beyond the buffer) */
+  static thread_local PyramidScratch scratch;
+  size_t pixels = (size_t) img->width * img->height;
+  size_t padded = (size_t) img->width * (img->height + 2);
+
+  img1->data = reserveScratch(scratch.img, pixels);
+  img1->flag = 0;
+  sum1->data = reserveScratch(scratch.sum, padded);
+  sum1->flag = 0;
+  sqsum1->data = reserveScratch(scratch.sqsum, padded);
+  sqsum1->flag = 0;
+
+  /* pyramid levels scanned so far, and where this thread counts them */
+  int level = 0;
+  CascadeCounters *counters = threadCounters();
+
+  /* step timing, only taken when asked for */
+  std::chrono::steady_clock::time_point t;
+  if( timing )
+    {
+      timing->pyramid = timing->cascade = timing->group = 0;
+      t = std::chrono::steady_clock::now();
+    }
 
   /* initial scaling factor */
   factor = 1;
@@ -136,9 +328,6 @@ std::vector<MyRect> detectObjects( MyImage* _img, MySize minSize, MySize maxSize
   /* iterate over the image pyramid */
   for( factor = 1; ; factor *= scaleFactor )
     {
-      /* iteration counter */
-      iter_counter++;
-
       /* size of the image scaled up */
       MySize winSize = { myRound(winSize0.width*factor), myRound(winSize0.height*factor) };
 
@@ -165,21 +354,30 @@ std::vector<MyRect> detectObjects( MyImage* _img, MySize minSize, MySize maxSize
        ************************************/
       setImage(sz.width, sz.height, img1);
       setSumImage(sz.width, sz.height, sum1);
-      setSumImage(sz.width, sz.height, sqsum1);
+      setSqSumImage(sz.width, sz.height, sqsum1);
 
       /***************************************
        * Compute-intensive step:
        * building image pyramid by downsampling
        * downsampling using nearest neighbor
        **************************************/
-      nearestNeighbor(img, img1);
+      PERF_BEGIN(PERF_PYRAMID);
+      downsample(img->data, img->width, img->height, step, img1);
+      PERF_END(PERF_PYRAMID);
 
       /***************************************************
        * Compute-intensive step:
        * At each scale of the image pyramid,
        * compute a new integral and squared integral image
        ***************************************************/
+      PERF_BEGIN(PERF_INTEGRAL);
       integralImages(img1, sum1, sqsum1);
+      memset(sum1->data + sz.height*sz.width, 0, sizeof(int)*(sz.width + 1));
+      memset(sqsum1->data + sz.height*sz.width, 0, sizeof(sqsumtype)*(sz.width + 1));
+      PERF_END(PERF_INTEGRAL);
+
+      if( timing )
+	timing->pyramid += lap(&t);
 
       /* sets images for haar classifier cascade */
       /**************************************************
@@ -192,6 +390,7 @@ std::vector<MyRect> detectObjects( MyImage* _img, MySize minSize, MySize maxSize
        * but does not do compuation based on four coners.
        * The computation is done next in ScaleImage_Invoker
        *************************************************/
+      PERF_BEGIN(PERF_CASCADE);
       setImageForCascadeClassifier( cascade, sum1, sqsum1, stages_array, rectangles_array, scaled_rectangles_array);
 
       /****************************************************
@@ -203,18 +402,35 @@ std::vector<MyRect> detectObjects( MyImage* _img, MySize minSize, MySize maxSize
       ScaleImage_Invoker(cascade, factor, sum1->height, sum1->width,
 			 allCandidates, stages_array, stages_thresh_array, weights_array,
 			 alpha1_array, alpha2_array, tree_thresh_array, scaled_rectangles_array);
+      PERF_END(PERF_CASCADE);
+
+      count(counters->level_windows[std::min(level, STATS_LEVELS - 1)],
+	    (unsigned long long) (sum1->width - winSize0.width + 1) * (sum1->height - winSize0.height + 1));
+      level++;
+
+      if( timing )
+	timing->cascade += lap(&t);
 
     } /* end of the factor loop, finish all scales in pyramid*/
 
+  if( n_candidates )
+    *n_candidates = allCandidates.size();
+
+  count(counters->frames, 1);
+  count(counters->candidates, allCandidates.size());
+  if( allCandidates.size() > counters->candidates_max.load(std::memory_order_relaxed) )
+    counters->candidates_max.store(allCandidates.size(), std::memory_order_relaxed);
+
   if( minNeighbors != 0)
     {
+      PERF_BEGIN(PERF_GROUP);
       groupRectangles(allCandidates, minNeighbors, GROUP_EPS);
+      PERF_END(PERF_GROUP);
     }
 
-  freeImage(img1);
-  freeSumImage(sum1);
-  freeSumImage(sqsum1);
-  return allCandidates;
+  if( timing )
+    timing->group = lap(&t);
+
 
 }
 
@@ -254,10 +470,10 @@ unsigned int int_sqrt (unsigned int value)
   return a;
 }
 
-void setImageForCascadeClassifier( myCascade* _cascade, MyIntImage* _sum, MyIntImage* _sqsum, int *stages_array, int *rectangles_array, int **scaled_rectangles_array)
+void setImageForCascadeClassifier( myCascade* _cascade, MyIntImage* _sum, MySqSumImage* _sqsum, int *stages_array, int *rectangles_array, int **scaled_rectangles_array)
 {
   MyIntImage *sum = _sum;
-  MyIntImage *sqsum = _sqsum;
+  MySqSumImage *sqsum = _sqsum;
   myCascade* cascade = _cascade;
   int i, j, k;
   MyRect equRect;
@@ -346,27 +562,29 @@ inline int evalWeakClassifier(int variance_norm_factor, int p_offset, int tree_i
   /* the node threshold is multiplied by the standard deviation of the image */
   int t = tree_thresh_array[tree_index] * variance_norm_factor;
 
-  int sum = (*(scaled_rectangles_array[r_index] + p_offset)
+  /* the weighted rectangles wrap at 32 bits, as in the hardware kernel: the
+     sums are unsigned here so that large windows do not overflow an int */
+  unsigned int sum = (unsigned int) (*(scaled_rectangles_array[r_index] + p_offset)
 	     - *(scaled_rectangles_array[r_index + 1] + p_offset)
 	     - *(scaled_rectangles_array[r_index + 2] + p_offset)
 	     + *(scaled_rectangles_array[r_index + 3] + p_offset))
-    * weights_array[w_index];
+    * (unsigned int) weights_array[w_index];
 
 
-  sum += (*(scaled_rectangles_array[r_index+4] + p_offset)
+  sum += (unsigned int) (*(scaled_rectangles_array[r_index+4] + p_offset)
 	  - *(scaled_rectangles_array[r_index + 5] + p_offset)
 	  - *(scaled_rectangles_array[r_index + 6] + p_offset)
 	  + *(scaled_rectangles_array[r_index + 7] + p_offset))
-    * weights_array[w_index + 1];
+    * (unsigned int) weights_array[w_index + 1];
 
   if ((scaled_rectangles_array[r_index+8] != NULL))
-    sum += (*(scaled_rectangles_array[r_index+8] + p_offset)
+    sum += (unsigned int) (*(scaled_rectangles_array[r_index+8] + p_offset)
 	    - *(scaled_rectangles_array[r_index + 9] + p_offset)
 	    - *(scaled_rectangles_array[r_index + 10] + p_offset)
 	    + *(scaled_rectangles_array[r_index + 11] + p_offset))
-      * weights_array[w_index + 2];
+      * (unsigned int) weights_array[w_index + 2];
 
-  if(sum >= t)
+  if((int) sum >= t)
     return alpha2_array[tree_index];
   else
     return alpha1_array[tree_index];
@@ -456,7 +674,6 @@ int runCascadeClassifier( myCascade* _cascade, MyPoint pt, int start_stage, int
 	   **************************************************/
 
 	  stage_sum += evalWeakClassifier(variance_norm_factor, p_offset, haar_counter, w_index, r_index, weights_array, alpha1_array, alpha2_array, tree_thresh_array, scaled_rectangles_array);
-	  n_features++;
 	  haar_counter++;
 	  w_index+=3;
 	  r_index+=12;
@@ -490,6 +707,21 @@ void ScaleImage_Invoker( myCascade* _cascade, float _factor, int sum_row, int su
   int y1, y2, x2, x, y, step;
   std::vector<MyRect> *vec = &_vec;
 
+  /* windows leaving the cascade at each stage, the last slot for faces; */
+  /* kept on the stack and added to the thread's counters after the scan */
+  unsigned int exits[STATS_STAGES + 1] = {0};
+  int last_stage = std::min(cascade->n_stages, STATS_STAGES) - 1;
+
+  /* a window leaving after stage i evaluated the weak classifiers */
+  /* of stages 0 to i, so features are counted once per window */
+  std::vector<unsigned int> evaluated(cascade->n_stages);
+  unsigned long long features = 0;
+  for( int i = 0, n = 0; i < cascade->n_stages; i++ )
+    {
+      n += stages_array[i];
+      evaluated[i] = n;
+    }
+
   MySize winSize0 = cascade->orig_window_size;
   MySize winSize;
 
@@ -541,6 +773,8 @@ void ScaleImage_Invoker( myCascade* _cascade, float _factor, int sum_row, int su
 	 * The same cascade filter is used each time
 	 ********************************************/
 	result = runCascadeClassifier( cascade, p, 0, stages_array, stages_thresh_array, weights_array, alpha1_array, alpha2_array, tree_thresh_array, scaled_rectangles_array );
+	exits[result > 0 ? STATS_STAGES : std::min(-result, last_stage)]++;
+	features += evaluated[result > 0 ? cascade->n_stages - 1 : -result];
 
 	/*******************************************************
 	 * If a face is detected,
@@ -560,6 +794,12 @@ void ScaleImage_Invoker( myCascade* _cascade, float _factor, int sum_row, int su
 	    vec->push_back(r);
 	  }
       }
+
+  CascadeCounters *counters = threadCounters();
+  for( int i = 0; i <= last_stage; i++ )
+    count(counters->stage_rejections[i], exits[i]);
+  count(counters->accepted, exits[STATS_STAGES]);
+  count(counters->features, features);
 }
 
 /*****************************************************
@@ -568,15 +808,16 @@ void ScaleImage_Invoker( myCascade* _cascade, float _factor, int sum_row, int su
  * More info:
  * http://en.wikipedia.org/wiki/Summed_area_table
  ****************************************************/
-void integralImages( MyImage *src, MyIntImage *sum, MyIntImage *sqsum )
+void integralImages( MyImage *src, MyIntImage *sum, MySqSumImage *sqsum )
 {
-  int x, y, s, sq, t, tq;
+  int x, y, s, t;
+  sqsumtype sq, tq;
   unsigned char it;
   int height = src->height;
   int width = src->width;
   unsigned char *data = src->data;
   int * sumData = sum->data;
-  int * sqsumData = sqsum->data;
+  sqsumtype * sqsumData = sqsum->data;
   for( y = 0; y < height; y++)
     {
       s = 0;
@@ -608,47 +849,15 @@ void integralImages( MyImage *src, MyIntImage *sum, MyIntImage *sqsum )
  **********************************************************/
 void nearestNeighbor (MyImage *src, MyImage *dst)
 {
-
-  int y;
-  int j;
-  int x;
-  int i;
-  unsigned char* t;
-  unsigned char* p;
-  int w1 = src->width;
-  int h1 = src->height;
-  int w2 = dst->width;
-  int h2 = dst->height;
-
-  int rat = 0;
-
-  unsigned char* src_data = src->data;
-  unsigned char* dst_data = dst->data;
-
-
-  int x_ratio = (int)((w1<<16)/w2) +1;
-  int y_ratio = (int)((h1<<16)/h2) +1;
-
-  for (i=0;i<h2;i++)
-    {
-      t = dst_data + i*w2;
-      y = ((i*y_ratio)>>16);
-      p = src_data + y*w1;
-      rat = 0;
-      for (j=0;j<w2;j++)
-	{
-	  x = (rat>>16);
-	  *t++ = p[x];
-	  rat += x_ratio;
-	}
-    }
+  downsample(src->data, src->width, src->height, src->width, dst);
 }
 
-void readTextClassifier(int **_stages_array, int **_rectangles_array,
+int loadTextClassifier(const char *info_path, const char *class_path,
+	int *_n_stages, int *_total_nodes,
+	int **_stages_array, int **_rectangles_array,
 	int **_weights_array,	int **_alpha1_array, int **_alpha2_array,
-	int **_tree_thresh_array, int **_stages_thresh_array,
-	int ***_scaled_rectangles_array)//(myCascade * cascade)
-{	
+	int **_tree_thresh_array, int **_stages_thresh_array)
+{
   /*number of stages of the cascade classifier*/
   int stages = 0;
   /*total number of weak classifiers (one node each)*/
@@ -658,7 +867,10 @@ void readTextClassifier(int **_stages_array, int **_rectangles_array,
   int r_index = 0;
   int w_index = 0;
   int tree_index = 0;
-  FILE *finfo = fopen("sw/info.txt", "r");
+  FILE *finfo = fopen(info_path, "r");
+
+  if (finfo == NULL)
+    return -1;
 
   /**************************************************
    how many stages are in the cascaded filter?
@@ -671,9 +883,22 @@ void readTextClassifier(int **_stages_array, int **_rectangles_array,
     }
   i = 0;
 
-	if (stages) {
+  if (stages <= 0)
+    {
+      fclose(finfo);
+      return -1;
+    }
+
+  FILE *fp = fopen(class_path, "r");
+
+  if (fp == NULL)
+    {
+      fclose(finfo);
+      return -1;
+    }
+
   *_stages_array = (int *)malloc(sizeof(int)*stages);
-  
+
   int *stages_array = *_stages_array;
 
   /**************************************************
@@ -682,7 +907,7 @@ void readTextClassifier(int **_stages_array, int **_rectangles_array,
    * starting from second line.
    * (in the 5kk73 example, from line 2 to line 26)
    *************************************************/
-  while ( fgets (mystring , 12 , finfo) != NULL )
+  while ( i < stages && fgets (mystring , 12 , finfo) != NULL )
     {
       stages_array[i] = atoi(mystring);
       total_nodes += stages_array[i];
@@ -690,6 +915,12 @@ void readTextClassifier(int **_stages_array, int **_rectangles_array,
     }
   fclose(finfo);
 
+  if (i < stages)
+    {
+      free(stages_array);
+      fclose(fp);
+      return -1;
+    }
 
   /* TODO: use matrices where appropriate */
   /***********************************************
@@ -698,7 +929,6 @@ void readTextClassifier(int **_stages_array, int **_rectangles_array,
    * some arrays need to be splitted or duplicated
    **********************************************/
   *_rectangles_array = (int *)malloc(sizeof(int)*total_nodes*12);
-  *_scaled_rectangles_array = (int **)malloc(sizeof(int*)*total_nodes*12);
   *_weights_array = (int *)malloc(sizeof(int)*total_nodes*3);
   *_alpha1_array = (int*)malloc(sizeof(int)*total_nodes);
   *_alpha2_array = (int*)malloc(sizeof(int)*total_nodes);
@@ -711,9 +941,6 @@ void readTextClassifier(int **_stages_array, int **_rectangles_array,
   int *alpha2_array = *_alpha2_array;
   int *tree_thresh_array = *_tree_thresh_array;
   int *stages_thresh_array = *_stages_thresh_array;
-  int **scaled_rectangles_array = *_scaled_rectangles_array;
-
-  FILE *fp = fopen("sw/class.txt", "r");
 
   /******************************************
    * Read the filter parameters in class.txt
@@ -794,7 +1021,35 @@ void readTextClassifier(int **_stages_array, int **_rectangles_array,
 	} /* end of j loop */
     } /* end of i loop */
   fclose(fp);
-  } else exit(1);
+
+  *_n_stages = stages;
+  *_total_nodes = total_nodes;
+
+  /* a short file leaves nodes unread */
+  if (tree_index < total_nodes)
+    {
+      releaseTextClassifier(stages_array, rectangles_array, weights_array,
+			    alpha1_array, alpha2_array, tree_thresh_array,
+			    stages_thresh_array, NULL);
+      return -1;
+    }
+  return 0;
+}
+
+void readTextClassifier(int **_stages_array, int **_rectangles_array,
+	int **_weights_array,	int **_alpha1_array, int **_alpha2_array,
+	int **_tree_thresh_array, int **_stages_thresh_array,
+	int ***_scaled_rectangles_array)//(myCascade * cascade)
+{
+  int stages, total_nodes;
+
+  if (loadTextClassifier("sw/info.txt", "sw/class.txt", &stages, &total_nodes,
+			 _stages_array, _rectangles_array, _weights_array,
+			 _alpha1_array, _alpha2_array, _tree_thresh_array,
+			 _stages_thresh_array) != 0)
+    exit(1);
+
+  *_scaled_rectangles_array = (int **)malloc(sizeof(int*)*total_nodes*12);
 }
 
 
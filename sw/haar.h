@@ -41,15 +41,13 @@
 #include "stdio-wrapper.h"
 
 #define MAXLABELS 50
-#define IMAGE_WIDTH 320
-#define IMAGE_HEIGHT 240
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 typedef  int sumtype;
-typedef int sqsumtype;
+typedef long long sqsumtype;
 
 typedef struct MyPoint
 {
@@ -88,7 +86,7 @@ typedef struct myCascade
     int inv_window_area;
 
     MyIntImage sum;
-    MyIntImage sqsum;
+    MySqSumImage sqsum;
 
     // pointers to the corner of the actual detection window
     sqsumtype *pq0, *pq1, *pq2, *pq3;
@@ -96,16 +94,61 @@ typedef struct myCascade
 
 } myCascade;
 
+/* time spent in each step of one detectObjects call, in nanoseconds */
+typedef struct
+{
+    long long pyramid;  /* downsampling and integral images */
+    long long cascade;  /* classifier scan over all windows */
+    long long group;    /* grouping of overlapping candidates */
+} MyTiming;
+
+/* cascade statistics are kept per level and stage up to these limits; */
+/* deeper pyramids and longer cascades share the last slot */
+#define STATS_LEVELS 32
+#define STATS_STAGES 32
+
+/* work done by the cascade, counted by each thread for itself */
+typedef struct
+{
+    unsigned long long frames;                     /* detectObjects calls */
+    unsigned long long windows;                    /* windows sent through the cascade */
+    unsigned long long level_windows[STATS_LEVELS]; /* of which on each pyramid level */
+    unsigned long long stage_rejections[STATS_STAGES]; /* windows rejected at each stage */
+    unsigned long long accepted;                   /* windows that passed every stage */
+    unsigned long long features;                   /* weak classifiers evaluated */
+    unsigned long long candidates;                 /* candidates before grouping, all frames */
+    unsigned long long candidates_max;             /* most candidates in a single frame */
+} MyCascadeStats;
+
 
 
+/* compute integral images */
+void integralImages( MyImage *src, MyIntImage *sum, MySqSumImage *sqsum );
+
+/* scale down the image */
+void ScaleImage_Invoker( myCascade* _cascade, float _factor, int sum_row, int sum_col, std::vector<MyRect>& _vec, int *stages_array, int *stages_thresh_array, int *weights_array, int *alpha1_array, int *alpha2_array, int *tree_thresh_array, int **scaled_rectangles_array);
+
+/* compute scaled image */
+void nearestNeighbor (MyImage *src, MyImage *dst);
+
 /* sets images for haar classifier cascade */
 //void setImageForCascadeClassifier( myCascade* cascade, MyIntImage* sum, MyIntImage* sqsum);
-void setImageForCascadeClassifier( myCascade* _cascade, MyIntImage* _sum, MyIntImage* _sqsum, int *stages_array, int *rectangles_array, int **scaled_rectangles_array);
+void setImageForCascadeClassifier( myCascade* _cascade, MyIntImage* _sum, MySqSumImage* _sqsum, int *stages_array, int *rectangles_array, int **scaled_rectangles_array);
 
 /* runs the cascade on the specified window */
 //int runCascadeClassifier(myCascade* cascade, MyPoint pt, int start_stage);
 int runCascadeClassifier(myCascade* _cascade, MyPoint pt, int start_stage, int *stages_array, int *stages_thresh_array, int *weights_array, int *alpha1_array, int *alpha2_array, int *tree_thresh_array, int **scaled_rectangles_array);
 
+/* reads the classifier from info_path (stages) and class_path (nodes) */
+/* into newly allocated arrays, returns 0 or -1 if a file is missing or short */
+int loadTextClassifier(const char *info_path, const char *class_path,
+	int *n_stages, int *total_nodes,
+	int **stages_array, int **rectangles_array,
+	int **weights_array,	int **alpha1_array, int **alpha2_array,
+	int **tree_thresh_array, int **stages_thresh_array);
+
+/* loadTextClassifier on sw/info.txt and sw/class.txt, exits on failure; */
+/* also allocates the scaled rectangles of one cascade */
 void readTextClassifier(int **stages_array, int **rectangles_array,
 	int **weights_array,	int **alpha1_array, int **alpha2_array,
 	int **tree_thresh_array, int **stages_thresh_array,
@@ -120,19 +163,36 @@ void releaseTextClassifier(int *stages_array, int *rectangles_array,
 //void groupRectangles(MyRect* _vec, int groupThreshold, float eps);
 void groupRectangles(std::vector<MyRect>& _vec, int groupThreshold, float eps);
 
-/* draw white bounding boxes around detected faces */
-void drawRectangle(unsigned char* image, MyRect r);
+/* label rectangles that overlap within eps, returns the number of classes */
+int partition(std::vector<MyRect>& _vec, std::vector<int>& labels, float eps);
+
+/* draw bounding boxes around detected faces, in place on an interleaved frame */
+void drawRectangle(unsigned char* image, int width, int height, int step, int channels, MyRect r);
 
 //void detectObjects( MyImage* image, MySize minSize, MySize maxSize,
 //		myCascade* cascade, MyRect *result,
 //		float scale_factor,
 //		int min_neighbors);
 
-std::vector<MyRect> detectObjects( MyImage* _img, MySize minSize, MySize maxSize,
-					myCascade* cascade, float scaleFactor, int minNeighbors,
-					int *stages_array, int *rectangles_array, int *weights_array,
-					int *alpha1_array, int *alpha2_array, int *tree_thresh_array,
-					int *stages_thresh_array, int **scaled_rectangles_array);
+/* rows of _img start step bytes apart (at least _img->width), */
+/* it is only read, so any part of a larger image can be scanned in place */
+/* candidates is cleared and receives the faces; its storage is reused, */
+/* like the pyramid buffers, which every thread keeps between calls */
+/* n_candidates (may be NULL) receives the number of windows found before grouping */
+/* timing (may be NULL) receives the time spent in each step */
+void detectObjects( MyImage* _img, int step, MySize minSize, MySize maxSize,
+		    myCascade* cascade, float scaleFactor, int minNeighbors,
+		    int *stages_array, int *rectangles_array, int *weights_array,
+		    int *alpha1_array, int *alpha2_array, int *tree_thresh_array,
+		    int *stages_thresh_array, int **scaled_rectangles_array,
+		    std::vector<MyRect>& candidates, int *n_candidates, MyTiming *timing);
+
+/* counters of the calling thread since it started */
+void getThreadCascadeStats( MyCascadeStats *stats );
+
+/* counters summed over every thread that ran the cascade, */
+/* including threads that have exited */
+void getCascadeStats( MyCascadeStats *stats );
 
 #ifdef __cplusplus
 }
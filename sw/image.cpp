@@ -169,3 +169,31 @@ void setSumImage(int width, int height, MyIntImage *image)
 	image->width = width;
 	image->height = height;
 }
+
+void createSqSumImage(int width, int height, MySqSumImage *image)
+{
+	image->width = width;
+	image->height = height;
+	image->flag = 1;
+	image->data = (long long *)malloc(sizeof(long long)*(height*width));
+}
+
+int freeSqSumImage(MySqSumImage* image)
+{
+	if (image->flag == 0)
+	{
+		printf("no image to delete\n");
+		return -1;
+	}
+	else
+	{
+		free(image->data); 
+		return 0;
+	}
+}
+
+void setSqSumImage(int width, int height, MySqSumImage *image)
+{
+	image->width = width;
+	image->height = height;
+}
@@ -61,12 +61,25 @@ typedef struct
 }
 MyIntImage;
 
+/* squared integral image, 64 bits as squares of large images overflow an int */
+typedef struct 
+{
+	int width;
+	int height;
+	long long* data;
+	int flag;
+}
+MySqSumImage;
+
 void createImage(int width, int height, MyImage *image);
 void createSumImage(int width, int height, MyIntImage *image);
 int freeImage(MyImage* image);
 int freeSumImage(MyIntImage* image);
 void setImage(int width, int height, MyImage *image);
 void setSumImage(int width, int height, MyIntImage *image);
+void createSqSumImage(int width, int height, MySqSumImage *image);
+int freeSqSumImage(MySqSumImage* image);
+void setSqSumImage(int width, int height, MySqSumImage *image);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,453 @@
+/*===============================================================*/
+/*                                                               */
+/*                       kernel_bench.cpp                        */
+/*                                                               */
+/*      Micro-benchmarks of the CPU detector's hot kernels.      */
+/*                                                               */
+/*===============================================================*/
+
+// standard C/C++ headers
+#include <getopt.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC
+#endif
+
+// required OpenCV headers
+#include <opencv2/core.hpp>
+#include <opencv2/videoio.hpp>
+
+// other headers
+#include "haar.h"
+#include "preprocess.h"
+
+// Non-face windows timed per pyramid level; all face windows are timed.
+#define MAX_NONFACE_WINDOWS 512
+
+typedef struct {
+	int warmup;
+	int repetitions;
+	cv::Size size;
+	std::vector<std::string> inputs;
+} bench_config;
+
+typedef struct {
+	myCascade cascade;
+	int *stages_array;
+	int *rectangles_array;
+	int *weights_array;
+	int *alpha1_array;
+	int *alpha2_array;
+	int *tree_thresh_array;
+	int *stages_thresh_array;
+	int **scaled_rectangles_array;
+} classifier;
+
+typedef struct {
+	float factor;
+	MyImage img;
+	MyIntImage sum;
+	MySqSumImage sqsum;
+} pyramid_level;
+
+// Reference cycles per nanosecond, 0 where there is no cycle counter.
+static double cycles_per_ns = 0;
+
+static void calibrate_cycles(void) {
+#ifdef HAVE_TSC
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	unsigned long long tsc = __rdtsc();
+
+	while (std::chrono::steady_clock::now() - start < std::chrono::milliseconds(100));
+
+	double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+	cycles_per_ns = (__rdtsc() - tsc) / ns;
+#endif
+}
+
+// Median time of one call, in nanoseconds, after `warmup` untimed calls.
+template <typename F>
+static double measure(F kernel, const bench_config &config) {
+	for (int i = 0; i < config.warmup; i++) kernel();
+
+	std::vector<double> ns(config.repetitions);
+	for (int i = 0; i < config.repetitions; i++) {
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		kernel();
+		ns[i] = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	std::nth_element(ns.begin(), ns.begin() + ns.size() / 2, ns.end());
+	return ns[ns.size() / 2];
+}
+
+static void print_header(void) {
+	std::cout << std::left << std::setw(30) << "kernel" << std::setw(24) << "detail" << std::right
+		<< std::setw(12) << "median us"
+		<< std::setw(16) << "work"
+		<< std::setw(12) << "cyc/unit"
+		<< std::setw(14) << "units/s" << std::endl;
+}
+
+// One result line: `work` units of `unit` were processed in `ns`.
+static void report(const std::string &kernel, const std::string &detail, double work, const char *unit, double ns) {
+	std::stringstream work_stream;
+	work_stream << (long) work << " " << unit;
+
+	std::cout << std::left << std::setw(30) << kernel << std::setw(24) << detail << std::right
+		<< std::fixed << std::setprecision(2) << std::setw(12) << ns / 1000.0
+		<< std::setw(16) << work_stream.str();
+
+	if (cycles_per_ns > 0 && work > 0) std::cout << std::setw(12) << ns * cycles_per_ns / work;
+	else std::cout << std::setw(12) << "-";
+
+	if (ns > 0) std::cout << std::setw(14) << std::setprecision(0) << work / (ns / 1e9);
+	std::cout << std::endl;
+}
+
+// Same steps as detectObjects: every level whose size still fits the
+// training window, one buffer set per level.
+static std::vector<pyramid_level> create_pyramid(MyImage *img, const classifier &c, float scaleFactor) {
+	std::vector<pyramid_level> levels;
+	MySize winSize0 = c.cascade.orig_window_size;
+
+	for (float factor = 1; ; factor *= scaleFactor) {
+		int width = img->width / factor;
+		int height = img->height / factor;
+		if (width < winSize0.width || height < winSize0.height) break;
+
+		pyramid_level level;
+		level.factor = factor;
+		createImage(width, height, &level.img);
+		// Windows on the last row read one row past the integral images,
+		// as in detectObjects.
+		createSumImage(width, height + 2, &level.sum);
+		createSqSumImage(width, height + 2, &level.sqsum);
+		setSumImage(width, height, &level.sum);
+		setSqSumImage(width, height, &level.sqsum);
+		memset(level.sum.data, 0, sizeof(int) * width * (height + 2));
+		memset(level.sqsum.data, 0, sizeof(long long) * width * (height + 2));
+		levels.push_back(level);
+	}
+
+	return levels;
+}
+
+static void free_pyramid(std::vector<pyramid_level> &levels) {
+	for (unsigned i = 0; i < levels.size(); i++) {
+		freeImage(&levels[i].img);
+		freeSumImage(&levels[i].sum);
+		freeSqSumImage(&levels[i].sqsum);
+	}
+	levels.clear();
+}
+
+static void run_frame(const std::string &name, const cv::Mat &gray, classifier &c, const bench_config &config) {
+	const float scaleFactor = 1.2f;
+	const float GROUP_EPS = 0.4f;
+	const int minNeighbours = 1;
+
+	MyImage input;
+	input.width = gray.cols;
+	input.height = gray.rows;
+	input.maxgrey = 255;
+	input.data = gray.data;
+	input.flag = 1;
+
+	std::vector<pyramid_level> levels = create_pyramid(&input, c, scaleFactor);
+
+	double pixels = 0;
+	for (unsigned l = 0; l < levels.size(); l++) pixels += levels[l].img.width * levels[l].img.height;
+
+	std::cout << "\n== " << name << ": " << gray.cols << "x" << gray.rows << ", "
+		<< levels.size() << " pyramid levels ==" << std::endl;
+	print_header();
+
+	double ns = measure([&]() {
+		for (unsigned l = 0; l < levels.size(); l++) nearestNeighbor(&input, &levels[l].img);
+	}, config);
+	report("nearestNeighbor", "all levels", pixels, "px", ns);
+
+	ns = measure([&]() {
+		for (unsigned l = 0; l < levels.size(); l++) integralImages(&levels[l].img, &levels[l].sum, &levels[l].sqsum);
+	}, config);
+	report("integralImages", "all levels", pixels, "px", ns);
+
+	ns = measure([&]() {
+		setImageForCascadeClassifier(&c.cascade, &levels[0].sum, &levels[0].sqsum,
+			c.stages_array, c.rectangles_array, c.scaled_rectangles_array);
+	}, config);
+	report("setImageForCascadeClassifier", "", c.cascade.total_nodes, "nodes", ns);
+
+	std::vector<MyRect> candidates;
+	std::vector<MyRect> found;
+
+	double face_ns = 0, nonface_ns = 0;
+	long face_windows = 0, nonface_windows = 0, nonface_stages = 0;
+
+	for (unsigned l = 0; l < levels.size(); l++) {
+		pyramid_level &level = levels[l];
+		setImageForCascadeClassifier(&c.cascade, &level.sum, &level.sqsum,
+			c.stages_array, c.rectangles_array, c.scaled_rectangles_array);
+
+		// Sort this level's windows into faces and non-faces once, with the
+		// same scan order and bounds as ScaleImage_Invoker.
+		int x2 = level.sum.width - c.cascade.orig_window_size.width;
+		int y2 = level.sum.height - c.cascade.orig_window_size.height;
+		long windows = (long) (x2 + 1) * (y2 + 1);
+
+		std::vector<MyPoint> faces, nonfaces;
+		int stride = std::max(1L, windows / MAX_NONFACE_WINDOWS);
+		long n = 0;
+
+		for (int x = 0; x <= x2; x++) {
+			for (int y = 0; y <= y2; y++, n++) {
+				MyPoint p = {x, y};
+				int result = runCascadeClassifier(&c.cascade, p, 0, c.stages_array, c.stages_thresh_array,
+					c.weights_array, c.alpha1_array, c.alpha2_array, c.tree_thresh_array, c.scaled_rectangles_array);
+
+				if (result > 0) faces.push_back(p);
+				else if (n % stride == 0) {
+					nonfaces.push_back(p);
+					nonface_stages += 1 - result;
+				}
+			}
+		}
+
+		ns = measure([&]() {
+			found.clear();
+			ScaleImage_Invoker(&c.cascade, level.factor, level.sum.height, level.sum.width, found,
+				c.stages_array, c.stages_thresh_array, c.weights_array, c.alpha1_array, c.alpha2_array,
+				c.tree_thresh_array, c.scaled_rectangles_array);
+		}, config);
+
+		std::stringstream detail;
+		detail << "L" << l << " " << level.sum.width << "x" << level.sum.height << " " << found.size() << " hits";
+		report("ScaleImage_Invoker", detail.str(), windows, "windows", ns);
+
+		candidates.insert(candidates.end(), found.begin(), found.end());
+
+		if (!faces.empty()) {
+			face_ns += measure([&]() {
+				for (unsigned i = 0; i < faces.size(); i++) {
+					runCascadeClassifier(&c.cascade, faces[i], 0, c.stages_array, c.stages_thresh_array,
+						c.weights_array, c.alpha1_array, c.alpha2_array, c.tree_thresh_array, c.scaled_rectangles_array);
+				}
+			}, config);
+			face_windows += faces.size();
+		}
+
+		if (!nonfaces.empty()) {
+			nonface_ns += measure([&]() {
+				for (unsigned i = 0; i < nonfaces.size(); i++) {
+					runCascadeClassifier(&c.cascade, nonfaces[i], 0, c.stages_array, c.stages_thresh_array,
+						c.weights_array, c.alpha1_array, c.alpha2_array, c.tree_thresh_array, c.scaled_rectangles_array);
+				}
+			}, config);
+			nonface_windows += nonfaces.size();
+		}
+	}
+
+	if (face_windows) report("runCascadeClassifier", "face windows", face_windows, "windows", face_ns);
+	else std::cout << std::left << std::setw(30) << "runCascadeClassifier" << "face windows: none in this frame" << std::endl;
+
+	if (nonface_windows) {
+		std::stringstream detail;
+		detail << "non-face, " << std::fixed << std::setprecision(1) << nonface_stages / (double) nonface_windows << " stages";
+		report("runCascadeClassifier", detail.str(), nonface_windows, "windows", nonface_ns);
+	}
+
+	if (!candidates.empty()) {
+		std::vector<int> labels;
+		ns = measure([&]() {
+			partition(candidates, labels, GROUP_EPS);
+		}, config);
+		report("partition", "", candidates.size(), "rects", ns);
+
+		// The copy is part of every call; it is small next to the grouping.
+		ns = measure([&]() {
+			found.assign(candidates.begin(), candidates.end());
+			groupRectangles(found, minNeighbours, GROUP_EPS);
+		}, config);
+
+		std::stringstream detail;
+		detail << found.size() << " faces";
+		report("groupRectangles", detail.str(), candidates.size(), "rects", ns);
+	}
+
+	free_pyramid(levels);
+}
+
+// Deterministic pseudo-random pixels; almost every window is rejected by
+// the first stages.
+static cv::Mat noise_frame(cv::Size size) {
+	cv::Mat gray(size, CV_8UC1);
+
+	unsigned int state = 12345;
+	for (int i = 0; i < gray.rows * gray.cols; i++) {
+		state = state * 1103515245 + 12345;
+		gray.data[i] = state >> 24;
+	}
+
+	return gray;
+}
+
+static void fill_ellipse(cv::Mat &gray, float cx, float cy, float rx, float ry, unsigned char value) {
+	for (int y = std::max(0, (int) (cy - ry)); y <= std::min(gray.rows - 1, (int) (cy + ry)); y++) {
+		for (int x = std::max(0, (int) (cx - rx)); x <= std::min(gray.cols - 1, (int) (cx + rx)); x++) {
+			float dx = (x - cx) / rx, dy = (y - cy) / ry;
+			if (dx * dx + dy * dy <= 1) gray.data[y * gray.cols + x] = value;
+		}
+	}
+}
+
+// Cartoon faces of several sizes on a gradient: head, eyes, brows, nose
+// and mouth are enough for the cascade to accept them at some levels.
+static cv::Mat faces_frame(cv::Size size) {
+	cv::Mat gray(size, CV_8UC1);
+
+	for (int y = 0; y < gray.rows; y++) {
+		for (int x = 0; x < gray.cols; x++) gray.data[y * gray.cols + x] = 80 + (x + y) / 8;
+	}
+
+	const float sizes[] = {30, 40, 50, 60, 80};
+	for (int i = 0; i < 5; i++) {
+		float s = sizes[i], cx = 30 + i * 50, cy = 60 + (i % 2) * 110;
+
+		fill_ellipse(gray, cx, cy, 0.42f * s, 0.55f * s, 170);
+		fill_ellipse(gray, cx - 0.17f * s, cy - 0.12f * s, 0.09f * s, 0.05f * s, 40);
+		fill_ellipse(gray, cx + 0.17f * s, cy - 0.12f * s, 0.09f * s, 0.05f * s, 40);
+		fill_ellipse(gray, cx - 0.17f * s, cy - 0.22f * s, 0.11f * s, 0.025f * s, 70);
+		fill_ellipse(gray, cx + 0.17f * s, cy - 0.22f * s, 0.11f * s, 0.025f * s, 70);
+		fill_ellipse(gray, cx, cy + 0.05f * s, 0.04f * s, 0.1f * s, 140);
+		fill_ellipse(gray, cx, cy + 0.25f * s, 0.15f * s, 0.04f * s, 60);
+	}
+
+	return gray;
+}
+
+// First frame of a video or image, scaled and converted like the pipeline does.
+static cv::Mat recorded_frame(const std::string &name, cv::Size size) {
+	cv::VideoCapture video(name);
+	cv::Mat decoded;
+
+	if (!video.isOpened() || !video.read(decoded) || decoded.empty()) return cv::Mat();
+
+	Preprocessor preprocess(size);
+	preprocess.set_source(video);
+	if (!preprocess.accepts(decoded)) return cv::Mat();
+
+	// The detector needs one contiguous plane.
+	return preprocess.run(decoded, NULL).clone();
+}
+
+static void print_usage(char *filename) {
+	std::cout << "usage: " << filename << " <options> <recorded videos or images...>\n";
+	std::cout << "  -w, --warmup [n]        untimed calls before measuring (default 3)\n";
+	std::cout << "  -n, --repetitions [n]   timed calls, the median is reported (default 21)\n";
+	std::cout << "  -s, --size [WxH]        detection size of every frame (default 320x240)\n";
+	std::cout << "  -h, --help              print this message\n";
+}
+
+static void parse_args(int argc, char **argv, bench_config &config) {
+	static struct option long_options[] = {
+		{"warmup",        required_argument, 0, 'w'},
+		{"repetitions",   required_argument, 0, 'n'},
+		{"size",          required_argument, 0, 's'},
+		{"help",          no_argument,       0, 'h'},
+		{0, 0, 0, 0}
+	};
+
+	config.warmup = 3;
+	config.repetitions = 21;
+	config.size = cv::Size(320, 240);
+
+	int c = 0;
+
+	while ((c = getopt_long(argc, argv, "w:n:s:h", long_options, NULL)) != -1) {
+		switch (c) {
+			case 'w':
+				config.warmup = atoi(optarg);
+				if (config.warmup < 0) {
+					std::cerr << "Invalid warm-up count: " << optarg << std::endl;
+					exit(-1);
+				}
+				break;
+			case 'n':
+				config.repetitions = atoi(optarg);
+				if (config.repetitions <= 0) {
+					std::cerr << "Invalid repetition count: " << optarg << std::endl;
+					exit(-1);
+				}
+				break;
+			case 's':
+				if (sscanf(optarg, "%dx%d", &config.size.width, &config.size.height) != 2 ||
+					config.size.width < 24 || config.size.height < 24) {
+					std::cerr << "Invalid frame size: " << optarg << std::endl;
+					exit(-1);
+				}
+				break;
+			case 'h':
+				print_usage(argv[0]);
+				exit(0);
+			default: {
+				print_usage(argv[0]);
+				exit(-1);
+			}
+		} // matching on arguments
+	} // while args present
+
+	for (int i = optind; i < argc; i++) {
+		config.inputs.push_back(argv[i]);
+	}
+}
+
+int main(int argc, char ** argv) {
+	std::cout << "Face Detection Kernel Benchmark\n";
+
+	bench_config config;
+	parse_args(argc, argv, config);
+
+	classifier c;
+	c.cascade.n_stages = 25;
+	c.cascade.total_nodes = 2913;
+	c.cascade.orig_window_size.height = 24;
+	c.cascade.orig_window_size.width = 24;
+
+	readTextClassifier(&c.stages_array, &c.rectangles_array, &c.weights_array, &c.alpha1_array, &c.alpha2_array,
+		&c.tree_thresh_array, &c.stages_thresh_array, &c.scaled_rectangles_array);
+
+	calibrate_cycles();
+
+	std::cout << "warm-up: " << config.warmup << ", repetitions: " << config.repetitions;
+	if (cycles_per_ns > 0) std::cout << ", cycle counter: " << std::fixed << std::setprecision(2) << cycles_per_ns << " GHz";
+	else std::cout << ", no cycle counter";
+	std::cout << std::endl;
+
+	run_frame("synthetic noise", noise_frame(config.size), c, config);
+	run_frame("synthetic faces", faces_frame(config.size), c, config);
+
+	for (unsigned i = 0; i < config.inputs.size(); i++) {
+		cv::Mat gray = recorded_frame(config.inputs[i], config.size);
+
+		if (gray.empty()) std::cerr << "Unable to read a frame from: " << config.inputs[i] << std::endl;
+		else run_frame(config.inputs[i], gray, c, config);
+	}
+
+	releaseTextClassifier(c.stages_array, c.rectangles_array, c.weights_array, c.alpha1_array, c.alpha2_array,
+		c.tree_thresh_array, c.stages_thresh_array, c.scaled_rectangles_array);
+
+	return 0;
+}
@@ -1,7 +1,5 @@
 #include "haar.h"
 
-int partition(std::vector<MyRect>& _vec, std::vector<int>& labels, float eps);
-
 int myMax(int a, int b)
 {
   if (a >= b)
@@ -208,27 +206,37 @@ int partition(std::vector<MyRect>& _vec, std::vector<int>& labels, float eps)
 }
 
 
-/* draw white bounding boxes around detected faces */
-void drawRectangle(unsigned char* image, MyRect r)
+/* draw bounding boxes around detected faces */
+/*****************************************************
+ * The box is drawn on the green channel of an
+ * interleaved frame (or on the only channel of a gray
+ * one), in place. Lines outside the frame are clipped.
+ *****************************************************/
+void drawRectangle(unsigned char* image, int width, int height, int step, int channels, MyRect r)
 {
-	int i;
-	int col = IMAGE_WIDTH;
+  int i;
+  int c = (channels > 1) ? 1 : 0;
 
-	for (i = 0; i < r.width; i++)
-	{
-		image[col*r.y + r.x + i] = 255;
-	}
-	for (i = 0; i < r.height; i++)
-	{
-		image[col*(r.y+i) + r.x + r.width] = 255;
-	}
-	for (i = 0; i < r.width; i++)
-	{
-		image[col*(r.y + r.height) + r.x + r.width - i] = 255;
-	}
-	for (i = 0; i < r.height; i++)
-	{
-		image[col*(r.y + r.height - i) + r.x] = 255;
-	}
+  int x0 = r.x, x1 = r.x + r.width;
+  int y0 = r.y, y1 = r.y + r.height;
 
+  int xs = myMax(x0, 0), xe = myMin(x1, width - 1);
+  int ys = myMax(y0, 0), ye = myMin(y1, height - 1);
+
+  /* top and bottom edges */
+  for (i = xs; i <= xe; i++)
+    {
+      if (y0 >= 0 && y0 < height)
+	image[step*y0 + channels*i + c] = 255;
+      if (y1 >= 0 && y1 < height)
+	image[step*y1 + channels*i + c] = 255;
+    }
+  /* left and right edges */
+  for (i = ys; i <= ye; i++)
+    {
+      if (x0 >= 0 && x0 < width)
+	image[step*i + channels*x0 + c] = 255;
+      if (x1 >= 0 && x1 < width)
+	image[step*i + channels*x1 + c] = 255;
+    }
 }